@@ -0,0 +1,157 @@
+#define _GNU_SOURCE                     // memfd_create(), MAP_HUGETLB
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+
+
+// reserve size bytes of address space starting on an align boundary (a power of 2, at least the page size)
+// return value: the reservation (PROT_NONE, nothing behind it yet), NULL if there is no room
+static uint8_t *oob_arena_reserve( size_t size, size_t align )
+{
+    uint8_t *map;
+    uint8_t *base;
+
+
+    map = (uint8_t *)mmap( NULL, size + align, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+    if( map == MAP_FAILED )
+        return NULL;
+
+    // give back the slack in front of the boundary and behind the end
+    base = (uint8_t *)(((uintptr_t)map + align - 1) & ~(uintptr_t)(align - 1));
+    if( base > map )
+        munmap( map, base - map );
+    if( map + align > base )
+        munmap( base + size, map + align - base );
+
+
+    return base;
+}
+
+
+int oob_arena_alloc( oob_arena *a, size_t size )
+{
+    void *p;
+    size_t map_size;
+
+
+    memset( a, 0, sizeof(*a) );
+    a->size = size;
+
+    if( size < OOB_ARENA_HUGE )
+    {
+        if( posix_memalign( &p, OOB_ARENA_ALIGN, size ? size : OOB_ARENA_ALIGN ) )
+            return -1;
+        a->base = (uint8_t *)p;
+        return 0;
+    }
+
+    map_size = (size + OOB_ARENA_HUGE - 1) & ~(size_t)(OOB_ARENA_HUGE - 1);
+
+    // hugetlb pages if there are any reserved - they are always huge-page aligned
+    p = mmap( NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+    if( p != MAP_FAILED )
+    {
+        a->base = (uint8_t *)p;
+        a->map_size = map_size;
+        a->huge = 1;
+        return 0;
+    }
+
+    // else ordinary pages on a huge-page boundary, for khugepaged / the page fault handler to back with THP
+    a->base = oob_arena_reserve( map_size, OOB_ARENA_HUGE );
+    if( !a->base )
+        return -1;
+    if( mmap( a->base, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0 ) == MAP_FAILED )
+    {
+        munmap( a->base, map_size );
+        a->base = NULL;
+        return -1;
+    }
+    madvise( a->base, map_size, MADV_HUGEPAGE );
+    a->map_size = map_size;
+
+
+    return 0;
+}
+
+
+// map the pages of fd twice, back to back, on an align boundary
+// return value: the first mapping, NULL if the address space or either mapping could not be had
+static uint8_t *oob_arena_map_mirror( int fd, size_t size, size_t align )
+{
+    uint8_t *base;
+
+
+    base = oob_arena_reserve( 2*size, align );
+    if( !base )
+        return NULL;
+
+    if( mmap( base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 ) == MAP_FAILED ||
+        mmap( base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 ) == MAP_FAILED )
+    {
+        munmap( base, 2*size );
+        return NULL;
+    }
+
+
+    return base;
+}
+
+
+int oob_arena_alloc_ring( oob_arena *a, size_t size )
+{
+    size_t page = sysconf( _SC_PAGESIZE );
+    int fd;
+
+
+    memset( a, 0, sizeof(*a) );
+    if( size == 0 || size % page )
+        return -1;
+
+    // a hugetlb memfd can be created and sized with no huge pages reserved - it is mapping it that fails then
+    if( size % OOB_ARENA_HUGE == 0 )
+    {
+        fd = memfd_create( "oob-ring", MFD_CLOEXEC | MFD_HUGETLB );
+        if( fd >= 0 )
+        {
+            if( ftruncate( fd, size ) == 0 )
+                a->base = oob_arena_map_mirror( fd, size, OOB_ARENA_HUGE );
+            close( fd );
+            a->huge = a->base != NULL;
+        }
+    }
+
+    if( !a->base )
+    {
+        fd = memfd_create( "oob-ring", MFD_CLOEXEC );
+        if( fd < 0 )
+            return -1;
+        if( ftruncate( fd, size ) == 0 )
+            a->base = oob_arena_map_mirror( fd, size, page );
+        close( fd );
+        if( !a->base )
+            return -1;
+    }
+
+    // the mappings keep the memfd alive, the fd isn't needed any more
+    a->size = size;
+    a->map_size = 2*size;
+    a->mirrored = 1;
+
+
+    return 0;
+}
+
+
+void oob_arena_free( oob_arena *a )
+{
+    if( a->map_size )
+        munmap( a->base, a->map_size );
+    else
+        free( a->base );
+
+    memset( a, 0, sizeof(*a) );
+}
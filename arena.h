@@ -0,0 +1,48 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+//-------------------------
+// Aligned buffer arenas
+//-------------------------
+//
+// the I/O buffers of the decoder - the stream ring, chunk and output buffers - come from here rather than malloc():
+//   every arena starts on a 64-byte boundary (a cache line, and the widest vector load)
+//   arenas of OOB_ARENA_HUGE bytes and more are mapped on a huge-page boundary - from the hugetlb pool if pages are
+//   reserved there (vm.nr_hugepages), else as ordinary pages the kernel is asked to back with transparent huge pages
+//   - a 2 MB page instead of 512 4 KB ones covers the whole of a typical chunk buffer with one TLB entry
+// a ring arena is a memfd mapped twice, back to back: base[size + n] is base[n], so anything that wraps around the
+// end of the ring (a frame, a read) is contiguous in memory without being copied - where memfd_create() is missing
+// or refused it fails, and the caller falls back to a copied mirror
+
+
+#define OOB_ARENA_ALIGN         64
+#define OOB_ARENA_HUGE          (2 << 20)   // huge page size, and the smallest arena put on huge pages
+
+
+typedef struct oob_arena
+{
+    uint8_t *base;
+    size_t size;                        // bytes asked for - a ring's mirror is another size bytes past these
+    size_t map_size;                    // bytes mapped at base, 0 if the arena came from posix_memalign()
+    int mirrored;                       // ring arena
+    int huge;                           // backed by hugetlb pages
+} oob_arena;
+
+
+// allocate size bytes, 64-byte aligned (huge-page aligned from OOB_ARENA_HUGE bytes on)
+// return value: 0 if successful, negative value if out of memory
+int oob_arena_alloc( oob_arena *a, size_t size );
+
+// allocate a ring of size bytes mirrored right behind itself (2*size bytes of address space)
+// size must be a multiple of the page size - rings that are a multiple of OOB_ARENA_HUGE go on huge pages if they can
+// return value: 0 if successful, negative value if the ring could not be mapped
+int oob_arena_alloc_ring( oob_arena *a, size_t size );
+
+void oob_arena_free( oob_arena *a );
+
+
+#endif  // _ARENA_H
@@ -0,0 +1,420 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+
+
+typedef struct oob_daemon
+{
+    int epoll_fd;
+    int quit_fd;                        // eventfd - made readable (and left so, for every worker) when the last stream ends
+
+    oob_daemon_stream *streams;
+    int nstreams;
+    atomic_int active;                  // streams that haven't ended yet
+
+    int chunk_bytes;
+    int verbose;
+} oob_daemon;
+
+
+static void oob_daemon_sync_event( void *arg, int event, uint64_t stream_pos )
+{
+    oob_daemon_stream *s = (oob_daemon_stream *)arg;
+
+    fprintf( stderr, "%s: %s at byte %llu\n", s->input, event == OOB_SYNC_EVENT_LOCK ? "Sync locked" : "Sync lost", (unsigned long long)stream_pos );
+}
+
+
+// open the input of a stream non-blocking, and the fd to poll it with
+// return value: 0 if successful, negative value if it could not be opened
+static int oob_daemon_open_input( oob_daemon_stream *s )
+{
+    struct sockaddr_un addr;
+    struct stat st;
+
+
+    if( !strncmp( s->input, "unix:", 5 ) )
+    {
+        s->in_fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+        if( s->in_fd < 0 )
+            return -1;
+
+        memset( &addr, 0, sizeof(addr) );
+        addr.sun_family = AF_UNIX;
+        strncpy( addr.sun_path, s->input + 5, sizeof(addr.sun_path)-1 );
+        if( connect( s->in_fd, (struct sockaddr *)&addr, sizeof(addr) ) < 0 )
+            return -1;
+    }
+    else if( !strcmp( s->input, "-" ) )
+        s->in_fd = dup( STDIN_FILENO );
+    else
+        s->in_fd = open( s->input, O_RDONLY | O_NONBLOCK );
+
+    if( s->in_fd < 0 || fstat( s->in_fd, &st ) < 0 )
+        return -1;
+    s->in_flags = fcntl( s->in_fd, F_GETFL );
+    fcntl( s->in_fd, F_SETFL, s->in_flags | O_NONBLOCK );
+
+    // a regular file is always readable (and epoll refuses it) - poll an eventfd that always is instead
+    if( S_ISREG( st.st_mode ) )
+        s->poll_fd = eventfd( 1, 0 );
+    else
+        s->poll_fd = s->in_fd;
+
+
+    return s->poll_fd < 0 ? -1 : 0;
+}
+
+
+// write all len bytes to fd (the outputs are blocking - a slow sink holds up its own stream only)
+// SIGPIPE is ignored while the daemon runs, a sink whose reader has gone fails with EPIPE and ends its own stream only
+static int oob_daemon_write( int fd, const uint8_t *buf, int len )
+{
+    int n;
+
+
+    while( len > 0 )
+    {
+        n = write( fd, buf, len );
+        if( n < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+
+
+    return 0;
+}
+
+
+// read one chunk of the stream (less if that's all there is right now), then decode and write out the packets it completes
+// called by the one worker that owns the stream
+// return value: 1 if the stream has ended, 0 if it should be polled again
+static int oob_daemon_service( oob_daemon *d, oob_daemon_stream *s )
+{
+    uint8_t *buf;
+    int budget = d->chunk_bytes;
+    int len;
+    int n;
+
+
+    while( budget > 0 )
+    {
+        buf = oob_stream_write_ptr( &s->stream, &len );
+        if( len == 0 )
+            break;                      // ring full - decode first
+        if( len > budget )
+            len = budget;
+
+        n = read( s->in_fd, buf, len );
+        if( n > 0 )
+        {
+            oob_stream_commit( &s->stream, n );
+            budget -= n;
+            continue;
+        }
+        if( n < 0 && errno == EINTR )
+            continue;
+        if( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) )
+            break;
+
+        if( n < 0 )
+        {
+            fprintf( stderr, "%s: error reading input - %s\n", s->input, strerror( errno ) );
+            s->error = 1;
+        }
+        s->eof = 1;
+        break;
+    }
+
+    while( (n = oob_stream_read_packets( &s->stream, s->out, s->out_packets )) > 0 )
+    {
+        if( (s->udp ? oob_udp_write( s->udp, s->out, n ) : oob_daemon_write( s->out_fd, s->out, n * 188 )) < 0 )
+        {
+            fprintf( stderr, "%s: error writing output '%s' - %s\n", s->input, s->output, strerror( errno ) );
+            s->error = 1;
+            s->eof = 1;
+            break;
+        }
+    }
+
+
+    return s->eof;
+}
+
+
+static void oob_daemon_end_stream( oob_daemon *d, oob_daemon_stream *s )
+{
+    uint64_t one = 1;
+
+
+    epoll_ctl( d->epoll_fd, EPOLL_CTL_DEL, s->poll_fd, NULL );
+    if( s->in_flags >= 0 )
+        fcntl( s->in_fd, F_SETFL, s->in_flags );
+
+    // the packets short of a whole datagram go out now
+    if( s->udp && oob_udp_close( s->udp ) < 0 )
+    {
+        fprintf( stderr, "%s: error writing output '%s' - %s\n", s->input, s->output, strerror( errno ) );
+        s->error = 1;
+    }
+
+    fprintf( stderr, "%s: %llu bytes in, %llu TS packets out\n", s->input, (unsigned long long)s->decoder.in_byte_count, (unsigned long long)s->decoder.out_packet_count );
+    if( s->decoder.do_fec )
+        fprintf( stderr, "%s: Processed FEC blocks: %llu, errors: %llu, corrected: %llu\n", s->input, (unsigned long long)s->decoder.fec_total_block_count, (unsigned long long)s->decoder.fec_error_count, (unsigned long long)s->decoder.fec_corrected_block_count );
+    if( d->verbose )
+        fprintf( stderr, "%s: Sync locked: %llu, lost: %llu, flywheeled frames: %llu\n", s->input, (unsigned long long)s->decoder.sync.lock_count, (unsigned long long)s->decoder.sync.loss_count, (unsigned long long)s->decoder.sync.flywheel_count );
+    if( d->verbose && s->decoder.pid_filter )
+        fprintf( stderr, "%s: TS packets dropped by the PID filter: %llu\n", s->input, (unsigned long long)s->decoder.pid_dropped_count );
+    if( d->verbose && s->udp )
+        fprintf( stderr, "%s: UDP datagrams sent: %llu, refused by the destination: %llu\n", s->input, (unsigned long long)s->udp->datagrams, (unsigned long long)s->udp->refused );
+
+    if( atomic_fetch_sub( &d->active, 1 ) == 1 )
+    {
+        if( write( d->quit_fd, &one, sizeof(one) ) < 0 )
+            fprintf( stderr, "Error - unable to stop the daemon workers.\n" );
+    }
+}
+
+
+static void *oob_daemon_worker( void *arg )
+{
+    oob_daemon *d = (oob_daemon *)arg;
+    oob_daemon_stream *s;
+    struct epoll_event ev;
+    int n;
+
+
+    for( ;; )
+    {
+        n = epoll_wait( d->epoll_fd, &ev, 1, -1 );
+        if( n < 0 && errno == EINTR )
+            continue;
+        if( n < 0 )
+            break;
+        if( n == 0 )
+            continue;
+
+        s = (oob_daemon_stream *)ev.data.ptr;
+        if( !s )
+            break;                      // quit_fd - level-triggered, so every worker sees it
+
+        if( oob_daemon_service( d, s ) )
+        {
+            oob_daemon_end_stream( d, s );
+            continue;
+        }
+
+        // hand the stream back to epoll - it goes to the back of the ready list if there is more to read
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.ptr = s;
+        epoll_ctl( d->epoll_fd, EPOLL_CTL_MOD, s->poll_fd, &ev );
+    }
+
+
+    return NULL;
+}
+
+
+// decode every stream in specs[] (nspecs "<input>=<output>" strings) on nworkers threads until all inputs have ended
+// return value: 0 if successful, negative value if the daemon could not be started or a stream failed
+int oob_daemon_run( char **specs, int nspecs, int nworkers, int chunk_bytes, int udp_sndbuf, oob_metrics *metrics, const oob_decoder *proto, int verbose )
+{
+    oob_daemon d;
+    oob_daemon_stream *s;
+    pthread_t *workers = NULL;
+    struct epoll_event ev;
+    struct sigaction sa;
+    struct sigaction old_sigpipe;
+    int nstarted = 0;
+    int ret = -1;
+    int n;
+    char *sep;
+
+
+    memset( &d, 0, sizeof(d) );
+    d.chunk_bytes = chunk_bytes;
+    d.verbose = verbose;
+    d.nstreams = nspecs;
+    d.quit_fd = -1;
+    atomic_init( &d.active, nspecs );
+
+    // one dead FIFO / stdout reader must not take every other stream down with it
+    memset( &sa, 0, sizeof(sa) );
+    sa.sa_handler = SIG_IGN;
+    sigaction( SIGPIPE, &sa, &old_sigpipe );
+
+    d.epoll_fd = epoll_create1( 0 );
+    d.quit_fd = eventfd( 0, 0 );
+    d.streams = (oob_daemon_stream *)calloc( nspecs, sizeof(oob_daemon_stream) );
+    workers = (pthread_t *)calloc( nworkers, sizeof(pthread_t) );
+    if( d.epoll_fd < 0 || d.quit_fd < 0 || !d.streams || !workers )
+    {
+        fprintf( stderr, "Error - unable to set up the daemon - aborting.\n" );
+        goto end_free;
+    }
+
+    for( n=0; n<nspecs; n++ )
+    {
+        s = &d.streams[n];
+        s->in_fd = s->out_fd = s->poll_fd = -1;
+        s->in_flags = -1;
+    }
+
+    for( n=0; n<nspecs; n++ )
+    {
+        s = &d.streams[n];
+
+        strncpy( s->spec, specs[n], sizeof(s->spec)-1 );
+        sep = strrchr( s->spec, '=' );
+        if( !sep || sep == s->spec || !sep[1] )
+        {
+            fprintf( stderr, "Error - stream '%s' is not <input>=<output> - aborting.\n", specs[n] );
+            goto end_free;
+        }
+        *sep = 0;
+        s->input = s->spec;
+        s->output = sep + 1;
+
+        if( oob_daemon_open_input( s ) < 0 )
+        {
+            fprintf( stderr, "Error - unable to open input '%s' - %s - aborting.\n", s->input, strerror( errno ) );
+            goto end_free;
+        }
+
+        if( oob_udp_is_url( s->output ) )
+        {
+            s->udp = (oob_udp_sink *)malloc( sizeof(oob_udp_sink) );
+            if( !s->udp || oob_udp_open( s->udp, s->output, udp_sndbuf ) < 0 )
+            {
+                fprintf( stderr, "Error - unable to open output '%s' - %s - aborting.\n", s->output, strerror( errno ) );
+                goto end_free;
+            }
+        }
+        else if( !strcmp( s->output, "-" ) )
+            s->out_fd = dup( STDOUT_FILENO );
+        else
+            s->out_fd = open( s->output, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+        if( s->out_fd < 0 && !s->udp )
+        {
+            fprintf( stderr, "Error - unable to open output '%s' - %s - aborting.\n", s->output, strerror( errno ) );
+            goto end_free;
+        }
+
+        oob_decoder_init( &s->decoder, proto->do_fec );
+        s->decoder.sync.lock_syncs = proto->sync.lock_syncs;
+        s->decoder.sync.unlock_misses = proto->sync.unlock_misses;
+        s->decoder.pid_filter = proto->pid_filter;
+        if( verbose )
+        {
+            s->decoder.sync.event = oob_daemon_sync_event;
+            s->decoder.sync.event_arg = s;
+        }
+
+        // each chunk's packets are decoded before the next chunk is read - room for a chunk plus the frame the sync
+        // tracker holds back
+        s->out_packets = (chunk_bytes + OOB_STREAM_MIRROR) / 384 * 2 + 2;
+        if( oob_arena_alloc( &s->out_arena, s->out_packets * 188 ) == 0 )
+            s->out = s->out_arena.base;
+        if( !s->out || oob_stream_init( &s->stream, &s->decoder, chunk_bytes + OOB_STREAM_MIRROR ) < 0 )
+        {
+            fprintf( stderr, "Error - unable to allocate buffers for '%s' - aborting.\n", s->input );
+            goto end_free;
+        }
+        if( metrics )
+            oob_metrics_add( metrics, s->input, &s->decoder );
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if( epoll_ctl( d.epoll_fd, EPOLL_CTL_ADD, d.quit_fd, &ev ) < 0 )
+        goto end_free;
+
+    for( n=0; n<nspecs; n++ )
+    {
+        s = &d.streams[n];
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.ptr = s;
+        if( epoll_ctl( d.epoll_fd, EPOLL_CTL_ADD, s->poll_fd, &ev ) < 0 )
+        {
+            fprintf( stderr, "Error - unable to poll input '%s' - %s - aborting.\n", s->input, strerror( errno ) );
+            goto end_free;
+        }
+    }
+
+
+    for( n=0; n<nworkers; n++ )
+    {
+        if( pthread_create( &workers[n], NULL, oob_daemon_worker, &d ) )
+            break;
+        nstarted++;
+    }
+    if( nstarted == 0 )
+    {
+        fprintf( stderr, "Error - unable to start daemon worker threads - aborting.\n" );
+        goto end_free;
+    }
+
+    for( n=0; n<nstarted; n++ )
+        pthread_join( workers[n], NULL );
+
+    ret = 0;
+    for( n=0; n<nspecs; n++ )
+    {
+        if( d.streams[n].error )
+            ret = -2;
+    }
+
+
+end_free:
+    if( d.streams )
+    {
+        for( n=0; n<nspecs; n++ )
+        {
+            s = &d.streams[n];
+            if( s->poll_fd >= 0 && s->poll_fd != s->in_fd )
+                close( s->poll_fd );
+            if( s->in_fd >= 0 && s->in_flags >= 0 )
+                fcntl( s->in_fd, F_SETFL, s->in_flags );
+            if( s->in_fd >= 0 )
+                close( s->in_fd );
+            if( s->out_fd >= 0 )
+                close( s->out_fd );
+            if( s->udp )
+                oob_udp_close( s->udp );
+            free( s->udp );
+            if( metrics )
+                oob_metrics_remove( metrics, &s->decoder );
+            oob_stream_free( &s->stream );
+            oob_decoder_free( &s->decoder );
+            oob_arena_free( &s->out_arena );
+        }
+    }
+    free( d.streams );
+    free( workers );
+    if( d.quit_fd >= 0 )
+        close( d.quit_fd );
+    if( d.epoll_fd >= 0 )
+        close( d.epoll_fd );
+    sigaction( SIGPIPE, &old_sigpipe, NULL );
+
+
+    return ret;
+}
@@ -0,0 +1,64 @@
+#ifndef _DAEMON_H
+#define _DAEMON_H
+
+#include <stdint.h>
+
+#include "oobin.h"
+#include "stream.h"
+#include "udpout.h"
+#include "metrics.h"
+
+
+//---------------------------------
+// Multi-stream daemon
+//---------------------------------
+//
+// decodes many OOB feeds in one process - each stream is "<input>=<output>":
+//   input  - a file or FIFO path, "unix:<path>" to connect to a UNIX stream socket, or "-" for stdin
+//   output - a file or FIFO path the TS packets are written to, "-" for stdout, or "udp://<host>:<port>" /
+//            "rtp://<host>:<port>" to send them as datagrams (see udpout.h)
+//
+// all inputs are non-blocking and registered with one epoll set, the worker threads all wait on it:
+// each stream is registered EPOLLONESHOT, so the worker that gets its event owns the stream (its oob_stream ring and
+// oob_decoder) until it re-arms it - no locks per stream, and any worker can serve any stream
+// a worker reads at most one chunk of a stream, decodes the packets it completes and writes them out before re-arming
+// it, and the re-armed stream joins the back of epoll's ready list - so busy streams take turns chunk by chunk
+// regular files can't be polled, they are stood in for by an eventfd that is always readable
+// each stream has its own oob_decoder (the sync tracker and FEC statistics follow that stream's bitstream)
+
+
+typedef struct oob_daemon_stream
+{
+    char spec[256];                     // "<input>=<output>" as given
+    char *input;                        // point into spec[]
+    char *output;
+
+    int in_fd;
+    int in_flags;                       // file status flags of in_fd before O_NONBLOCK, -1 if not read yet - a dup()ed
+                                        // stdin shares them with the shell, they are put back when the stream ends
+    int out_fd;
+    oob_udp_sink *udp;                  // instead of out_fd for a udp:// or rtp:// output
+    int poll_fd;                        // registered with epoll - in_fd, or an eventfd standing in for a regular file
+    int eof;
+
+    oob_decoder decoder;
+    oob_stream stream;
+    oob_arena out_arena;
+    uint8_t *out;                       // TS packets decoded from one chunk - out_arena.base
+    int out_packets;                    // room in out[] in 188-byte packets
+
+    int error;
+} oob_daemon_stream;
+
+
+// decode every stream in specs[] (nspecs "<input>=<output>" strings) on nworkers threads until all inputs have ended
+// chunk_bytes is the most read from one stream before the worker moves on to another one
+// udp_sndbuf - socket send buffer size of the udp:// and rtp:// outputs, 0 = the system default
+// metrics - NULL, or the exporter each stream's decoder is added to (labelled with the stream's input)
+// the decoders of the streams are set up like *proto (do_fec, the sync tracker settings and the PID filter)
+// verbose - report sync lock / loss for each stream, and each stream's sync statistics at the end
+// return value: 0 if successful, negative value if the daemon could not be started or a stream failed
+int oob_daemon_run( char **specs, int nspecs, int nworkers, int chunk_bytes, int udp_sndbuf, oob_metrics *metrics, const oob_decoder *proto, int verbose );
+
+
+#endif  // _DAEMON_H
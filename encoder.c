@@ -0,0 +1,209 @@
+#include <string.h>
+#include <math.h>
+
+#include "encoder.h"
+
+
+//-----------------------------------------------------
+// The process going from TS data to the QPSK modulator:
+//-----------------------------------------------------
+
+void oob_encoder_init( oob_encoder *enc )
+{
+    memset( enc, 0, sizeof(*enc) );
+
+    oob_ecc_init();
+}
+
+
+// randomize, RS encode and interleave 2 TS packets (376 bytes - the first byte of each should be the 0x47 TS sync byte)
+// writes the 384 bytes of bitstream this frame completes to out[] - they begin with the frame's 0x47 sync byte
+void oob_encode_frame( oob_encoder *enc, const uint8_t *ts_in, uint8_t *out )
+{
+    uint8_t msg[94];
+    uint8_t block[96];
+    uint8_t *slot;
+    uint64_t b;
+    int j, k;
+
+
+    for( k=0; k<4; k++ )
+    {
+// 3. Randomizer - 94 data bytes of each block, the 2 parity bytes are gated out of the randomizing action
+        for( j=0; j<94; j++ )
+            msg[j] = ts_in[k*94 + j] ^ oob_rand_table[k*96 + j];
+
+// 2. Reed Solomon Encoder - 94 data bytes + 2 parity bytes
+        encode_data( &enc->rs, msg, 94, block );
+
+// 1. Interleaver - byte j goes (j%8) blocks further on in the bitstream
+        b = enc->nblocks++;
+        for( j=0; j<96; j++ )
+            enc->line[(b + j%8) & (OOB_ENC_LINE_BLOCKS-1)][j] = block[j];
+
+        // no block after this one writes to its own position - it is complete
+        slot = enc->line[b & (OOB_ENC_LINE_BLOCKS-1)];
+        memcpy( out + k*96, slot, 96 );
+        memset( slot, 0, 96 );
+    }
+}
+
+
+// write the 768 bytes still in the interleaver delay line to out[] - the last frame can be decoded after these
+void oob_encoder_flush( oob_encoder *enc, uint8_t *out )
+{
+    uint8_t *slot;
+    int k;
+
+
+    for( k=0; k<8; k++ )
+    {
+        slot = enc->line[(enc->nblocks + k) & (OOB_ENC_LINE_BLOCKS-1)];
+        memcpy( out + k*96, slot, 96 );
+        memset( slot, 0, 96 );
+    }
+}
+
+
+//----------------------------
+// Channel impairment model
+//----------------------------
+
+// xorshift64* - fast, and the same stream of impairments for the same seed on every platform
+static uint64_t oob_imp_rand( oob_impairments *imp )
+{
+    imp->rng ^= imp->rng >> 12;
+    imp->rng ^= imp->rng << 25;
+    imp->rng ^= imp->rng >> 27;
+
+    return imp->rng * 0x2545F4914F6CDD1DULL;
+}
+
+
+// uniform in [0, 1)
+static double oob_imp_uniform( oob_impairments *imp )
+{
+    return (oob_imp_rand( imp ) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+// a random byte value that is not 0 - XORed in, it always changes the byte
+static uint8_t oob_imp_error( oob_impairments *imp )
+{
+    return 1 + oob_imp_rand( imp ) % 255;
+}
+
+
+// # of bytes before the next event that happens with probability rate at each byte (geometric distribution)
+static int64_t oob_imp_skip( oob_impairments *imp, double rate )
+{
+    if( rate <= 0.0 )
+        return INT64_MAX;
+    if( rate >= 1.0 )
+        return 0;
+
+    return (int64_t)floor( log( 1.0 - oob_imp_uniform( imp ) ) / log1p( -rate ) );
+}
+
+
+// rates and burst_len must be filled in before this is called - the counters are reset
+void oob_impairments_init( oob_impairments *imp, uint64_t seed )
+{
+    imp->rng = seed ? seed : 1;
+    imp->next_error = oob_imp_skip( imp, imp->symbol_error_rate );
+    imp->next_burst = oob_imp_skip( imp, imp->burst_rate );
+    imp->burst_left = 0;
+
+    imp->symbol_errors = 0;
+    imp->bursts = 0;
+    imp->slips = 0;
+    imp->sync_errors = 0;
+}
+
+
+// impair one 384-byte frame of bitstream from oob_encode_frame() in place
+// data[] must have room for 385 bytes (a slip can insert one)
+// if flags is not NULL it gets a byte for each byte of data[] - 1 for the bytes that were hit, 0 for the rest
+// return value: # of bytes in data[] now - 383, 384 or 385
+int oob_impair_frame( oob_impairments *imp, uint8_t *data, uint8_t *flags )
+{
+    uint8_t no_flags[385];
+    int len = 384;
+    int n;
+
+
+    if( !flags )
+        flags = no_flags;
+    memset( flags, 0, 385 );
+
+    if( imp->sync_error_rate > 0.0 && oob_imp_uniform( imp ) < imp->sync_error_rate )
+    {   // the 0x47 or the 0x64 sync byte
+        n = (oob_imp_rand( imp ) & 1) * 192;
+        data[n] ^= oob_imp_error( imp );
+        flags[n] = 1;
+        imp->sync_errors++;
+    }
+
+    while( imp->next_error < len )
+    {
+        data[imp->next_error] ^= oob_imp_error( imp );
+        flags[imp->next_error] = 1;
+        imp->symbol_errors++;
+        imp->next_error += 1 + oob_imp_skip( imp, imp->symbol_error_rate );
+    }
+    if( imp->next_error != INT64_MAX )
+        imp->next_error -= len;
+
+    // a burst carries on into the next frames if it runs past the end of this one
+    for( n=0; n<len; n++ )
+    {
+        if( imp->burst_left == 0 )
+        {
+            if( imp->next_burst >= len - n )
+                break;
+            n += imp->next_burst;
+            imp->burst_left = imp->burst_len;
+            imp->next_burst = oob_imp_skip( imp, imp->burst_rate );
+            imp->bursts++;
+        }
+        data[n] ^= oob_imp_error( imp );
+        flags[n] = 1;
+        imp->burst_left--;
+    }
+    if( imp->burst_left == 0 && imp->next_burst != INT64_MAX )
+        imp->next_burst -= len - n;
+
+    if( imp->slip_rate > 0.0 && oob_imp_uniform( imp ) < imp->slip_rate )
+    {
+        n = oob_imp_rand( imp ) % len;
+        if( oob_imp_rand( imp ) & 1 )
+        {   // a byte dropped
+            memmove( data + n, data + n + 1, len - n - 1 );
+            memmove( flags + n, flags + n + 1, len - n - 1 );
+            len--;
+        }
+        else
+        {   // a byte inserted
+            memmove( data + n + 1, data + n, len - n );
+            memmove( flags + n + 1, flags + n, len - n );
+            data[n] = oob_imp_rand( imp );
+            flags[n] = 1;
+            len++;
+        }
+        imp->slips++;
+    }
+
+
+    return len;
+}
+
+
+// fill data[] with len random bytes (garbage before the first frame, ...)
+void oob_impair_garbage( oob_impairments *imp, uint8_t *data, int len )
+{
+    int n;
+
+
+    for( n=0; n<len; n++ )
+        data[n] = oob_imp_rand( imp );
+}
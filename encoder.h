@@ -0,0 +1,90 @@
+#ifndef _ENCODER_H
+#define _ENCODER_H
+
+#include <stdint.h>
+
+#include "oobin.h"
+
+
+//-----------------------------------------------------
+// The process going from TS data to the QPSK modulator:
+//-----------------------------------------------------
+//
+// the decoder's steps in reverse, used to make test bitstreams with a known ground truth (the TS that went in)
+//
+// 3. Randomizer           - XOR each pair of TS packets with oob_rand_table[] (the parity positions are gated out)
+// 2. Reed Solomon Encoder - encode_data() appends 2 parity bytes to each 94-byte block
+// 1. Interleaver          - byte j of block k goes to position 96*k + j + 96*(j%8) of the bitstream, the inverse of
+//                           oob_de_interleaver() - so each block spreads over the 8 blocks' worth of bitstream after it
+
+
+// interleaver delay line - bitstream blocks still collecting bytes of the blocks before them
+#define OOB_ENC_LINE_BLOCKS     16          // power of 2, more than the 8 blocks one block spreads over
+
+
+typedef struct oob_encoder
+{
+    RS_STATE rs;
+    uint8_t line[OOB_ENC_LINE_BLOCKS][96];
+    uint64_t nblocks;                       // # of blocks interleaved so far
+} oob_encoder;
+
+
+void oob_encoder_init( oob_encoder *enc );
+
+
+// randomize, RS encode and interleave 2 TS packets (376 bytes - the first byte of each should be the 0x47 TS sync byte)
+// writes the 384 bytes of bitstream this frame completes to out[] - they begin with the frame's 0x47 sync byte
+void oob_encode_frame( oob_encoder *enc, const uint8_t *ts_in, uint8_t *out );
+
+
+// write the 768 bytes still in the interleaver delay line to out[] - the last frame can be decoded after these
+void oob_encoder_flush( oob_encoder *enc, uint8_t *out );
+
+
+//----------------------------
+// Channel impairment model
+//----------------------------
+//
+// errors are placed with geometric skips between them (no per-byte random draw), so a clean or lightly
+// impaired stream is generated at close to memcpy speed
+
+typedef struct oob_impairments
+{
+    double symbol_error_rate;               // probability of each byte being replaced by a random wrong value
+    double burst_rate;                      // probability of an error burst starting at each byte
+    int burst_len;                          // # of bytes hit by each burst
+    double slip_rate;                       // probability of a byte slip (a byte dropped or inserted) in each frame
+    double sync_error_rate;                 // probability of each frame's 0x47 or 0x64 sync byte being corrupted
+
+    // internal state
+    uint64_t rng;
+    int64_t next_error;                     // bytes to the next symbol error
+    int64_t next_burst;                     // bytes to the next burst start
+    int burst_left;                         // bytes left in the current burst
+
+    // what was injected
+    uint64_t symbol_errors;
+    uint64_t bursts;
+    uint64_t slips;
+    uint64_t sync_errors;
+} oob_impairments;
+
+
+// rates and burst_len must be filled in before this is called - the counters are reset
+void oob_impairments_init( oob_impairments *imp, uint64_t seed );
+
+
+// impair one 384-byte frame of bitstream from oob_encode_frame() in place
+// data[] must have room for 385 bytes (a slip can insert one)
+// if flags is not NULL it gets a byte for each byte of data[] - 1 for the bytes that were hit, 0 for the rest (the
+// erasure flags an ideal demodulator would give, see oob_decode_frame_erasures())
+// return value: # of bytes in data[] now - 383, 384 or 385
+int oob_impair_frame( oob_impairments *imp, uint8_t *data, uint8_t *flags );
+
+
+// fill data[] with len random bytes (garbage before the first frame, ...)
+void oob_impair_garbage( oob_impairments *imp, uint8_t *data, int len );
+
+
+#endif  // _ENCODER_H
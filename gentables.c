@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "oobin.h"
+
+
+//----------------------------------
+// Build-time table generator
+//----------------------------------
+//
+// run by make to write gftables.c - the GF(256) tables and the RS generator polynomial as const data, so nothing is
+// computed at startup, the tables live in read-only pages shared by every process running oobin, and there is no
+// first-block delay or init race for them
+// it also checks the randomizer tables pasted into randomizer.c against the LFSR (oob_calc_rand_table()) and fails
+// the build if they don't match
+//
+// usage: gentables > gftables.c
+
+
+#define PPOLY       0x11D               // p(X) = X^8 + X^4 + X^3 + X^2 + 1
+
+
+static uint8_t exp_table[512];
+static uint8_t log_table[256];
+
+
+static int gf_mult( int a, int b )
+{
+    if( a == 0 || b == 0 )
+        return 0;
+
+    return exp_table[log_table[a] + log_table[b]];
+}
+
+
+// powers of alpha (X) - two periods, so gexp[glog[a] + glog[b]] needs no reduction mod 255
+static void gen_exp_log( void )
+{
+    int x = 1;
+    int i;
+
+
+    for( i=0; i<255; i++ )
+    {
+        exp_table[i] = exp_table[i+255] = x;
+        log_table[x] = i;
+
+        x <<= 1;
+        if( x & 0x100 )
+            x ^= PPOLY;
+    }
+    exp_table[510] = exp_table[0];
+    exp_table[511] = exp_table[1];
+    log_table[0] = 0;                   // log(0) is undefined - 0 keeps lookups in range, gmult() masks the product
+}
+
+
+// g(X) = (X + α)(X + α^2)...(X + α^NPAR), lowest coefficient first - like compute_genpoly() in rs.c did at startup
+static void gen_genpoly( int *genpoly )
+{
+    int next[MAXDEG*2];
+    int i, j;
+
+
+    memset( genpoly, 0, MAXDEG*2 * sizeof(int) );
+    genpoly[0] = 1;
+
+    for( i=1; i<=NPAR; i++ )
+    {
+        memset( next, 0, sizeof(next) );
+        for( j=0; j<MAXDEG*2-1; j++ )
+        {
+            next[j] ^= gf_mult( genpoly[j], exp_table[i] );
+            next[j+1] ^= genpoly[j];
+        }
+        memcpy( genpoly, next, sizeof(next) );
+    }
+}
+
+
+static void print_bytes( const char *indent, const uint8_t *data, int len )
+{
+    int n;
+
+
+    for( n=0; n<len; n++ )
+        printf( "%s0x%02X%s", (n % 16) ? "" : indent, data[n], n == len-1 ? "\n" : (n % 16 == 15) ? ",\n" : "," );
+}
+
+
+// the tables pasted into randomizer.c must be what the LFSR gives, with the RS parity positions gated out of oob_rand_mask[]
+static int check_rand_tables( void )
+{
+    uint8_t table[384];
+    int n;
+
+
+    oob_calc_rand_table( table );
+
+    for( n=0; n<384; n++ )
+    {
+        if( oob_rand_table[n] != table[n] )
+        {
+            fprintf( stderr, "gentables: oob_rand_table[%d] is 0x%02X, the LFSR gives 0x%02X\n", n, oob_rand_table[n], table[n] );
+            return -1;
+        }
+        if( oob_rand_mask[n] != ((n % 96 < 94) ? table[n] : 0) )
+        {
+            fprintf( stderr, "gentables: oob_rand_mask[%d] is 0x%02X, should be 0x%02X\n", n, oob_rand_mask[n], (n % 96 < 94) ? table[n] : 0 );
+            return -1;
+        }
+    }
+
+
+    return 0;
+}
+
+
+int main( int argc, char **argv )
+{
+    uint8_t row[256];
+    int genpoly[MAXDEG*2];
+    int k, x;
+
+
+    if( check_rand_tables() < 0 )
+        return 1;
+
+    gen_exp_log();
+    gen_genpoly( genpoly );
+
+
+    printf( "/* generated by gentables - do not edit */\n\n" );
+    printf( "#include \"rscode-1.3/ecc.h\"\n\n" );
+
+    printf( "const unsigned char gexp[512] =\n{\n" );
+    print_bytes( "    ", exp_table, 512 );
+    printf( "};\n\n" );
+
+    printf( "const unsigned char glog[256] =\n{\n" );
+    print_bytes( "    ", log_table, 256 );
+    printf( "};\n\n" );
+
+    printf( "const unsigned char gexp_row[GF_ROWS][256] =\n{\n" );
+    for( k=0; k<GF_ROWS; k++ )
+    {
+        for( x=0; x<256; x++ )
+            row[x] = gf_mult( exp_table[k], x );
+        printf( "    {\n" );
+        print_bytes( "        ", row, 256 );
+        printf( "    },\n" );
+    }
+    printf( "};\n\n" );
+
+    printf( "const int genPoly[MAXDEG*2] =\n{\n    " );
+    for( k=0; k<MAXDEG*2; k++ )
+        printf( "0x%02X%s", genpoly[k], k == MAXDEG*2-1 ? "\n" : ", " );
+    printf( "};\n\n" );
+
+    printf( "#ifdef GF_MUL_TABLE\n" );
+    printf( "const unsigned char gmul_table[256][256] =\n{\n" );
+    for( k=0; k<256; k++ )
+    {
+        for( x=0; x<256; x++ )
+            row[x] = gf_mult( k, x );
+        printf( "    {\n" );
+        print_bytes( "        ", row, 256 );
+        printf( "    },\n" );
+    }
+    printf( "};\n" );
+    printf( "#endif\n" );
+
+
+    return 0;
+}
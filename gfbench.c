@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "rscode-1.3/ecc.h"
+
+
+//------------------------------------
+// GF(256) multiplication microbenchmark
+//------------------------------------
+//
+// times the ways the RS decoder can multiply in GF(256), on the machine it is run on:
+//   log/exp, branching  - the original out-of-line gmult() with a zero test
+//   log/exp, inline     - gexp[glog[a] + glog[b]] masked to 0 without a branch (the default gmult())
+//   64 KB table         - a full product table like gmul_table[a][b] (make GFTABLE=1) - one load, but 64 KB of cache when the operands are random
+//   row table           - gexp_row[k][x] for a fixed constant alpha^k (256 bytes per constant)
+// each is run on random operand pairs and on the dependent Horner chain of a 96-byte block syndrome (the decoder's case)
+// build with "make gfbench"
+
+
+#define BENCH_BYTES     65536
+#define BENCH_ROUNDS    2000
+
+
+static uint8_t a_buf[BENCH_BYTES];
+static uint8_t b_buf[BENCH_BYTES];
+static uint8_t mul_table[256][256];      // gmul_table[] is only compiled in with GFTABLE=1 - the bench has its own
+
+
+__attribute__((noinline))
+static int gmult_branch( int a, int b )
+{
+    if( a == 0 || b == 0 )
+        return 0;
+
+    return gexp[glog[a] + glog[b]];
+}
+
+
+static inline int gmult_logexp( int a, int b )
+{
+    return gexp[glog[a] + glog[b]] & -((a != 0) & (b != 0));
+}
+
+
+static inline int gmult_table( int a, int b )
+{
+    return mul_table[a][b];
+}
+
+
+static double bench_seconds( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void report( const char *test, const char *variant, double seconds, uint64_t ops, unsigned check )
+{
+    printf( "%-10s %-20s %8.3f ns/op   %8.1f Mop/s   (check %08x)\n", test, variant, seconds * 1e9 / ops, ops / seconds / 1e6, check );
+}
+
+
+// independent products of random operand pairs
+#define BENCH_PAIRS( name, expr )                                       \
+    do {                                                                \
+        unsigned check = 0;                                             \
+        double t0 = bench_seconds();                                    \
+        for( r=0; r<BENCH_ROUNDS; r++ )                                 \
+            for( n=0; n<BENCH_BYTES; n++ )                              \
+            {                                                           \
+                int a = a_buf[n], b = (b_buf[n] ^ r) & 0xFF;            \
+                check += (expr);                                        \
+            }                                                           \
+        report( "pairs", name, bench_seconds() - t0, (uint64_t)BENCH_ROUNDS * BENCH_BYTES, check ); \
+    } while( 0 )
+
+
+// syndrome S1 of each 96-byte block by Horner's rule - every multiply depends on the one before
+#define BENCH_HORNER( name, expr )                                      \
+    do {                                                                \
+        unsigned check = 0;                                             \
+        double t0 = bench_seconds();                                    \
+        for( r=0; r<BENCH_ROUNDS; r++ )                                 \
+            for( n=0; n+96<=BENCH_BYTES; n+=96 )                        \
+            {                                                           \
+                int sum = r & 0xFF;                                     \
+                for( k=0; k<96; k++ )                                   \
+                    sum = a_buf[n+k] ^ (expr);                          \
+                check += sum;                                           \
+            }                                                           \
+        report( "syndrome", name, bench_seconds() - t0, (uint64_t)BENCH_ROUNDS * (BENCH_BYTES/96) * 96, check ); \
+    } while( 0 )
+
+
+int main( int argc, char **argv )
+{
+    const uint8_t *row = NULL;
+    int alpha;
+    int r, n, k;
+
+
+    for( n=0; n<65536; n++ )
+        mul_table[n >> 8][n & 0xFF] = gmult_branch( n >> 8, n & 0xFF );
+
+    srand( 1 );
+    for( n=0; n<BENCH_BYTES; n++ )
+    {
+        a_buf[n] = rand();
+        b_buf[n] = rand();
+    }
+
+    // check the variants agree before timing them
+    for( n=0; n<65536; n++ )
+    {
+        if( gmult_branch( n >> 8, n & 0xFF ) != gmult_logexp( n >> 8, n & 0xFF ) || gmult_branch( n >> 8, n & 0xFF ) != gmult_table( n >> 8, n & 0xFF ) )
+        {
+            fprintf( stderr, "Error - GF multiply variants disagree at %d * %d - aborting.\n", n >> 8, n & 0xFF );
+            return 1;
+        }
+    }
+    for( k=0; k<GF_ROWS; k++ )
+    {
+        for( n=0; n<256; n++ )
+        {
+            if( gexp_row[k][n] != gmult_branch( gexp[k], n ) )
+            {
+                fprintf( stderr, "Error - gexp_row[%d][%d] is wrong - aborting.\n", k, n );
+                return 1;
+            }
+        }
+    }
+
+#ifdef GF_MUL_TABLE
+    printf( "gmult() in this build: 64 KB table\n\n" );
+#else
+    printf( "gmult() in this build: log/exp, inline\n\n" );
+#endif
+
+    BENCH_PAIRS( "log/exp, branching", gmult_branch( a, b ) );
+    BENCH_PAIRS( "log/exp, inline", gmult_logexp( a, b ) );
+    BENCH_PAIRS( "64 KB table", gmult_table( a, b ) );
+    printf( "\n" );
+
+    // multiplier alpha^1 (S1) unless another power is given - picked at run time, so the compiler can't fold it in
+    k = argc > 1 ? atoi( argv[1] ) % GF_ROWS : 1;
+    alpha = gexp[k];
+    row = gexp_row[k];
+
+    BENCH_HORNER( "log/exp, branching", gmult_branch( alpha, sum ) );
+    BENCH_HORNER( "log/exp, inline", gmult_logexp( alpha, sum ) );
+    BENCH_HORNER( "64 KB table", gmult_table( alpha, sum ) );
+    BENCH_HORNER( "row table", row[sum] );
+
+
+    return 0;
+}
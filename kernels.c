@@ -0,0 +1,760 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "oobin.h"
+#include "kernels.h"
+
+
+void (*oob_de_interleave_frame_kernel)( uint8_t *data_in, uint8_t *frame_out ) = oob_de_interleave_frame_scalar;
+void (*oob_de_frame_kernel)( uint8_t *data_in, uint8_t *ts_out ) = oob_de_frame_scalar;
+void (*oob_xor_kernel)( uint8_t *dst, const uint8_t *src, const uint8_t *key, int len ) = oob_xor_scalar;
+int (*oob_sync_scan_kernel)( uint8_t *data, int n ) = oob_sync_scan_scalar;
+
+
+static int oob_tier_cap = OOB_CPU_TIERS - 1;        // oob_kernels_force_tier()
+
+static const char *oob_tier_names[OOB_CPU_TIERS] = { "scalar", "sse4.1", "avx2", "gfni", "avx512" };
+
+// the variant each kernel ended up with, for oob_kernels_report()
+static const char *oob_sync_scan_variant = "scalar";
+static const char *oob_de_interleave_variant = "scalar";
+static const char *oob_de_frame_variant = "scalar";
+static const char *oob_xor_variant = "scalar";
+static const char *oob_syndrome_variant = "scalar";
+
+
+//-----------------
+// 3. Derandomizer
+//-----------------
+
+// scalar reference - 8 bytes at a time in a 64-bit word, memcpy() keeps the unaligned loads legal
+void oob_xor_scalar( uint8_t *dst, const uint8_t *src, const uint8_t *key, int len )
+{
+    uint64_t a;
+    uint64_t b;
+    int i = 0;
+
+
+    for( ; i+8<=len; i+=8 )
+    {
+        memcpy( &a, src+i, 8 );
+        memcpy( &b, key+i, 8 );
+        a ^= b;
+        memcpy( dst+i, &a, 8 );
+    }
+
+    for( ; i<len; i++ )
+        dst[i] = src[i] ^ key[i];
+}
+
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+
+//-------------------------------
+// 0. Synchronize bitstream
+//-------------------------------
+//
+// 16 / 32 / 64 candidate offsets per iteration: compare a vector at data+i with 0x47 and the vector 192 bytes later
+// with 0x64, AND the two byte masks - the lowest set bit is the first sync pair
+// the scalar reference finishes the last few candidates that don't fill a whole vector
+
+__attribute__((target("sse2")))
+static int oob_sync_scan_sse2( uint8_t *data, int n )
+{
+    const __m128i s47 = _mm_set1_epi8( 0x47 );
+    const __m128i s64 = _mm_set1_epi8( 0x64 );
+    unsigned m;
+    int i;
+
+
+    for( i=0; i+16<=n; i+=16 )
+    {
+        m = _mm_movemask_epi8( _mm_and_si128( _mm_cmpeq_epi8( _mm_loadu_si128( (__m128i *)(data+i) ), s47 ),
+                                              _mm_cmpeq_epi8( _mm_loadu_si128( (__m128i *)(data+i+192) ), s64 ) ) );
+        if( m )
+            return i + __builtin_ctz( m );
+    }
+
+
+    return i + oob_sync_scan_scalar( data+i, n-i );
+}
+
+
+__attribute__((target("avx2")))
+static int oob_sync_scan_avx2( uint8_t *data, int n )
+{
+    const __m256i s47 = _mm256_set1_epi8( 0x47 );
+    const __m256i s64 = _mm256_set1_epi8( 0x64 );
+    unsigned m;
+    int i;
+
+
+    for( i=0; i+32<=n; i+=32 )
+    {
+        m = _mm256_movemask_epi8( _mm256_and_si256( _mm256_cmpeq_epi8( _mm256_loadu_si256( (__m256i *)(data+i) ), s47 ),
+                                                    _mm256_cmpeq_epi8( _mm256_loadu_si256( (__m256i *)(data+i+192) ), s64 ) ) );
+        if( m )
+            return i + __builtin_ctz( m );
+    }
+
+
+    return i + oob_sync_scan_scalar( data+i, n-i );
+}
+
+
+__attribute__((target("avx512f,avx512bw")))
+static int oob_sync_scan_avx512( uint8_t *data, int n )
+{
+    const __m512i s47 = _mm512_set1_epi8( 0x47 );
+    const __m512i s64 = _mm512_set1_epi8( 0x64 );
+    __mmask64 m;
+    int i;
+
+
+    for( i=0; i+64<=n; i+=64 )
+    {
+        m = _mm512_cmpeq_epi8_mask( _mm512_loadu_si512( data+i ), s47 ) & _mm512_cmpeq_epi8_mask( _mm512_loadu_si512( data+i+192 ), s64 );
+        if( m )
+            return i + __builtin_ctzll( m );
+    }
+
+
+    return i + oob_sync_scan_scalar( data+i, n-i );
+}
+
+
+//-------------------
+// 1. De-interleaver
+//-------------------
+//
+// seen as 96-byte rows, the interleaved input of a frame is row r = data_in[96*r .. 96*r+95]
+// byte j of de-interleaved block k comes from row k + j%8, column j - the column never changes,
+// so de-interleaving is not a shuffle at all: it is a byte-wise select between rows k..k+7 with a pattern
+// that repeats every 8 columns, and every 16/32-byte vector of a row starts on a multiple of 8
+//
+// the select is done as a 3-level blend tree on the bits of j%8, shared between the 4 blocks of the frame:
+//   P[r] = bit 0 ? row r+1 : row r           r = 0..9
+//   Q[r] = bit 1 ? P[r+2]  : P[r]            r = 0..7     (row r + j%4)
+//   block k = bit 2 ? Q[k+4] : Q[k]          k = 0..3     (row k + j%8)
+// 10 + 8 + 4 = 22 blends per vector column for all 4 blocks, rows 0..10 are read once each
+
+
+__attribute__((target("sse4.1")))
+static inline void oob_de_interleave_column_sse41( uint8_t *data_in, int col, __m128i block[4] )
+{
+    const __m128i m0 = _mm_set_epi8( -1,0,-1,0,-1,0,-1,0, -1,0,-1,0,-1,0,-1,0 );
+    const __m128i m1 = _mm_set_epi8( -1,-1,0,0,-1,-1,0,0, -1,-1,0,0,-1,-1,0,0 );
+    const __m128i m2 = _mm_set_epi8( -1,-1,-1,-1,0,0,0,0, -1,-1,-1,-1,0,0,0,0 );
+    __m128i row[11];
+    __m128i p[10];
+    __m128i q[8];
+    int r;
+
+
+    for( r=0; r<11; r++ )
+        row[r] = _mm_loadu_si128( (__m128i *)(data_in + 96*r + col) );
+    for( r=0; r<10; r++ )
+        p[r] = _mm_blendv_epi8( row[r], row[r+1], m0 );
+    for( r=0; r<8; r++ )
+        q[r] = _mm_blendv_epi8( p[r], p[r+2], m1 );
+    for( r=0; r<4; r++ )
+        block[r] = _mm_blendv_epi8( q[r], q[r+4], m2 );
+}
+
+
+__attribute__((target("sse4.1")))
+static void oob_de_interleave_frame_sse41( uint8_t *data_in, uint8_t *frame_out )
+{
+    __m128i block[4];
+    int col;
+    int k;
+
+
+    for( col=0; col<96; col+=16 )
+    {
+        oob_de_interleave_column_sse41( data_in, col, block );
+        for( k=0; k<4; k++ )
+            _mm_storeu_si128( (__m128i *)(frame_out + 96*k + col), block[k] );
+    }
+}
+
+
+// the last vector of each block also covers the 2 parity bytes - they are overwritten by the start of the next block,
+// so blocks are stored in order, and the last vector of the frame goes through a bounce buffer so nothing past ts_out[375] is written
+__attribute__((target("sse4.1")))
+static void oob_de_frame_sse41( uint8_t *data_in, uint8_t *ts_out )
+{
+    __m128i out[6][4];
+    uint8_t tail[16];
+    int col;
+    int k;
+
+
+    for( col=0; col<6; col++ )
+    {
+        oob_de_interleave_column_sse41( data_in, col*16, out[col] );
+        for( k=0; k<4; k++ )
+            out[col][k] = _mm_xor_si128( out[col][k], _mm_loadu_si128( (__m128i *)(oob_rand_table + 96*k + col*16) ) );
+    }
+
+    for( k=0; k<4; k++ )
+    {
+        for( col=0; col<5; col++ )
+            _mm_storeu_si128( (__m128i *)(ts_out + 94*k + col*16), out[col][k] );
+
+        if( k < 3 )
+            _mm_storeu_si128( (__m128i *)(ts_out + 94*k + 80), out[5][k] );
+        else
+        {
+            _mm_storeu_si128( (__m128i *)tail, out[5][k] );
+            memcpy( ts_out + 94*k + 80, tail, 14 );
+        }
+    }
+}
+
+
+__attribute__((target("avx2")))
+static inline void oob_de_interleave_column_avx2( uint8_t *data_in, int col, __m256i block[4] )
+{
+    const __m256i m0 = _mm256_set1_epi64x( 0xFF00FF00FF00FF00ULL );
+    const __m256i m1 = _mm256_set1_epi64x( 0xFFFF0000FFFF0000ULL );
+    const __m256i m2 = _mm256_set1_epi64x( 0xFFFFFFFF00000000ULL );
+    __m256i row[11];
+    __m256i p[10];
+    __m256i q[8];
+    int r;
+
+
+    for( r=0; r<11; r++ )
+        row[r] = _mm256_loadu_si256( (__m256i *)(data_in + 96*r + col) );
+    for( r=0; r<10; r++ )
+        p[r] = _mm256_blendv_epi8( row[r], row[r+1], m0 );
+    for( r=0; r<8; r++ )
+        q[r] = _mm256_blendv_epi8( p[r], p[r+2], m1 );
+    for( r=0; r<4; r++ )
+        block[r] = _mm256_blendv_epi8( q[r], q[r+4], m2 );
+}
+
+
+__attribute__((target("avx2")))
+static void oob_de_interleave_frame_avx2( uint8_t *data_in, uint8_t *frame_out )
+{
+    __m256i block[4];
+    int col;
+    int k;
+
+
+    for( col=0; col<96; col+=32 )
+    {
+        oob_de_interleave_column_avx2( data_in, col, block );
+        for( k=0; k<4; k++ )
+            _mm256_storeu_si256( (__m256i *)(frame_out + 96*k + col), block[k] );
+    }
+}
+
+
+__attribute__((target("avx2")))
+static void oob_de_frame_avx2( uint8_t *data_in, uint8_t *ts_out )
+{
+    __m256i out[3][4];
+    uint8_t tail[32];
+    int col;
+    int k;
+
+
+    for( col=0; col<3; col++ )
+    {
+        oob_de_interleave_column_avx2( data_in, col*32, out[col] );
+        for( k=0; k<4; k++ )
+            out[col][k] = _mm256_xor_si256( out[col][k], _mm256_loadu_si256( (__m256i *)(oob_rand_table + 96*k + col*32) ) );
+    }
+
+    for( k=0; k<4; k++ )
+    {
+        _mm256_storeu_si256( (__m256i *)(ts_out + 94*k), out[0][k] );
+        _mm256_storeu_si256( (__m256i *)(ts_out + 94*k + 32), out[1][k] );
+
+        if( k < 3 )
+            _mm256_storeu_si256( (__m256i *)(ts_out + 94*k + 64), out[2][k] );
+        else
+        {
+            _mm256_storeu_si256( (__m256i *)tail, out[2][k] );
+            memcpy( ts_out + 94*k + 64, tail, 30 );
+        }
+    }
+}
+
+
+// 96 bytes = one 64-byte column with mask blends (one instruction each, no blend mask vectors) and one 32-byte AVX2 column
+// the 2 parity bytes at the end of each block are left out of the store with a write mask - no bounce buffer
+__attribute__((target("avx512f,avx512bw")))
+static inline void oob_de_interleave_column_avx512( uint8_t *data_in, int col, __m512i block[4] )
+{
+    const __mmask64 m0 = 0xAAAAAAAAAAAAAAAAULL;
+    const __mmask64 m1 = 0xCCCCCCCCCCCCCCCCULL;
+    const __mmask64 m2 = 0xF0F0F0F0F0F0F0F0ULL;
+    __m512i row[11];
+    __m512i p[10];
+    __m512i q[8];
+    int r;
+
+
+    for( r=0; r<11; r++ )
+        row[r] = _mm512_loadu_si512( data_in + 96*r + col );
+    for( r=0; r<10; r++ )
+        p[r] = _mm512_mask_blend_epi8( m0, row[r], row[r+1] );
+    for( r=0; r<8; r++ )
+        q[r] = _mm512_mask_blend_epi8( m1, p[r], p[r+2] );
+    for( r=0; r<4; r++ )
+        block[r] = _mm512_mask_blend_epi8( m2, q[r], q[r+4] );
+}
+
+
+__attribute__((target("avx512f,avx512bw")))
+static void oob_de_interleave_frame_avx512( uint8_t *data_in, uint8_t *frame_out )
+{
+    __m512i lo[4];
+    __m256i hi[4];
+    int k;
+
+
+    oob_de_interleave_column_avx512( data_in, 0, lo );
+    oob_de_interleave_column_avx2( data_in, 64, hi );
+    for( k=0; k<4; k++ )
+    {
+        _mm512_storeu_si512( frame_out + 96*k, lo[k] );
+        _mm256_storeu_si256( (__m256i *)(frame_out + 96*k + 64), hi[k] );
+    }
+}
+
+
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+static void oob_de_frame_avx512( uint8_t *data_in, uint8_t *ts_out )
+{
+    __m512i lo[4];
+    __m256i hi[4];
+    int k;
+
+
+    oob_de_interleave_column_avx512( data_in, 0, lo );
+    oob_de_interleave_column_avx2( data_in, 64, hi );
+    for( k=0; k<4; k++ )
+    {
+        lo[k] = _mm512_xor_si512( lo[k], _mm512_loadu_si512( oob_rand_table + 96*k ) );
+        hi[k] = _mm256_xor_si256( hi[k], _mm256_loadu_si256( (__m256i *)(oob_rand_table + 96*k + 64) ) );
+        _mm512_storeu_si512( ts_out + 94*k, lo[k] );
+        _mm256_mask_storeu_epi8( ts_out + 94*k + 64, (__mmask32)0x3FFFFFFF, hi[k] );
+    }
+}
+
+
+//-----------------
+// 3. Derandomizer
+//-----------------
+
+__attribute__((target("sse2")))
+static void oob_xor_sse2( uint8_t *dst, const uint8_t *src, const uint8_t *key, int len )
+{
+    int i = 0;
+
+
+    for( ; i+16<=len; i+=16 )
+        _mm_storeu_si128( (__m128i *)(dst+i), _mm_xor_si128( _mm_loadu_si128( (__m128i *)(src+i) ), _mm_loadu_si128( (__m128i *)(key+i) ) ) );
+
+    oob_xor_scalar( dst+i, src+i, key+i, len-i );
+}
+
+
+__attribute__((target("avx2")))
+static void oob_xor_avx2( uint8_t *dst, const uint8_t *src, const uint8_t *key, int len )
+{
+    int i = 0;
+
+
+    for( ; i+32<=len; i+=32 )
+        _mm256_storeu_si256( (__m256i *)(dst+i), _mm256_xor_si256( _mm256_loadu_si256( (__m256i *)(src+i) ), _mm256_loadu_si256( (__m256i *)(key+i) ) ) );
+
+    if( i+16<=len )
+    {
+        _mm_storeu_si128( (__m128i *)(dst+i), _mm_xor_si128( _mm_loadu_si128( (__m128i *)(src+i) ), _mm_loadu_si128( (__m128i *)(key+i) ) ) );
+        i += 16;
+    }
+
+    oob_xor_scalar( dst+i, src+i, key+i, len-i );
+}
+
+
+// the tail is done with a masked load/store, so there is no scalar loop at all
+__attribute__((target("avx512f,avx512bw")))
+static void oob_xor_avx512( uint8_t *dst, const uint8_t *src, const uint8_t *key, int len )
+{
+    __mmask64 m;
+    int i = 0;
+
+
+    for( ; i+64<=len; i+=64 )
+        _mm512_storeu_si512( dst+i, _mm512_xor_si512( _mm512_loadu_si512( src+i ), _mm512_loadu_si512( key+i ) ) );
+
+    if( i < len )
+    {
+        m = (__mmask64)(~0ULL >> (64 - (len-i)));
+        _mm512_mask_storeu_epi8( dst+i, m, _mm512_xor_si512( _mm512_maskz_loadu_epi8( m, src+i ), _mm512_maskz_loadu_epi8( m, key+i ) ) );
+    }
+}
+
+#endif
+
+
+// fixed pseudo-random test frame for the startup check - 1152 bytes, the span one frame decode reads
+static void oob_kernel_test_vector( uint8_t *data, int len )
+{
+    uint32_t x = 0x2545F491;
+    int i;
+
+
+    for( i=0; i<len; i++ )
+    {
+        x = x*1103515245 + 12345;
+        data[i] = x >> 23;
+    }
+}
+
+
+// check a de-interleave kernel against oob_de_interleaver() (the original per-block function) - 0 if bit-exact
+static int oob_check_de_interleave_frame( void (*kernel)( uint8_t *, uint8_t * ) )
+{
+    uint8_t in[1152];
+    uint8_t ref[384];
+    uint8_t out[384];
+    int n;
+
+
+    oob_kernel_test_vector( in, sizeof(in) );
+    for( n=0; n<4; n++ )
+        oob_de_interleaver( in + n*96, ref + n*96 );
+    kernel( in, out );
+
+
+    return memcmp( ref, out, sizeof(ref) );
+}
+
+
+// check a fused frame kernel against the scalar reference - 0 if bit-exact (and nothing written past the 376 output bytes)
+static int oob_check_de_frame( void (*kernel)( uint8_t *, uint8_t * ) )
+{
+    uint8_t in[1152];
+    uint8_t ref[376+32];
+    uint8_t out[376+32];
+
+
+    oob_kernel_test_vector( in, sizeof(in) );
+    memset( ref, 0xA5, sizeof(ref) );
+    memset( out, 0xA5, sizeof(out) );
+    oob_de_frame_scalar( in, ref );
+    kernel( in, out );
+
+
+    return memcmp( ref, out, sizeof(ref) );
+}
+
+
+// check an XOR kernel against the scalar reference over every length 0..200 and a few alignments - 0 if bit-exact
+static int oob_check_xor( void (*kernel)( uint8_t *, const uint8_t *, const uint8_t *, int ) )
+{
+    uint8_t in[256];
+    uint8_t ref[256];
+    uint8_t out[256];
+    int len;
+    int ofs;
+
+
+    oob_kernel_test_vector( in, sizeof(in) );
+    for( ofs=0; ofs<4; ofs++ )
+    {
+        for( len=0; len<=200; len++ )
+        {
+            memset( ref, 0xA5, sizeof(ref) );
+            memset( out, 0xA5, sizeof(out) );
+            oob_xor_scalar( ref+ofs, in+ofs, oob_rand_mask+ofs, len );
+            kernel( out+ofs, in+ofs, oob_rand_mask+ofs, len );
+            if( memcmp( ref, out, sizeof(ref) ) )
+                return -1;
+        }
+    }
+
+
+    return 0;
+}
+
+
+// check a sync scan kernel against the scalar reference - 0 if it finds the same offsets
+// sync pairs are planted at every position of a 64-byte vector, near the end of the scan, and nowhere at all
+static int oob_check_sync_scan( int (*kernel)( uint8_t *, int ) )
+{
+    uint8_t data[1024];
+    int pos;
+    int n;
+
+
+    for( pos=-1; pos<700; pos += (pos < 130 ? 1 : 37) )
+    {
+        oob_kernel_test_vector( data, sizeof(data) );
+        for( n=0; n<(int)sizeof(data); n++ )
+            if( data[n] == 0x47 )
+                data[n] = 0;        // no accidental sync pairs in the test vector
+        if( pos >= 0 )
+        {
+            data[pos] = 0x47;
+            data[pos+192] = 0x64;
+            data[pos+5] = 0x47;     // a 0x47 without its 0x64 must not match
+        }
+
+        for( n=0; n<=(int)sizeof(data)-192; n+=41 )
+            if( kernel( data, n ) != oob_sync_scan_scalar( data, n ) )
+                return -1;
+    }
+
+
+    return 0;
+}
+
+
+// check the syndrome kernels against Horner's rule (decode_data() without a kernel) - 0 if they give the same syndromes
+// an all-zero codeword and random ones, the batch kernel over a run of blocks that isn't a whole number of its groups
+static int oob_check_syndromes( void )
+{
+    uint8_t data[100*96];
+    uint8_t syn[NPAR*100];
+    int ref[NPAR];
+    int out[NPAR];
+    void (*kernel)( unsigned char *, int, int * ) = syndrome_kernel;
+    RS_STATE rs;
+    int k, j;
+
+
+    oob_kernel_test_vector( data, sizeof(data) );
+    memset( data, 0, 96 );
+
+    for( k=0; k<100; k++ )
+    {
+        syndrome_kernel = NULL;
+        decode_data( &rs, data + k*96, 96 );
+        syndrome_kernel = kernel;
+        for( j=0; j<NPAR; j++ )
+            ref[j] = rs.synBytes[j];
+
+        if( kernel )
+        {
+            kernel( data + k*96, 96, out );
+            if( memcmp( ref, out, sizeof(ref) ) )
+                return -1;
+        }
+
+        if( k == 0 && syndrome_batch_kernel )
+            decode_data_batch( data, 96, 96, 100, syn );
+        for( j=0; j<NPAR && syndrome_batch_kernel; j++ )
+        {
+            if( syn[j*100 + k] != ref[j] )
+                return -2;
+        }
+    }
+
+
+    return 0;
+}
+
+
+// the RS syndrome kernels (rscode-1.3/syndrome.c) only come in SSSE3 and up, the AVX-512 tier uses GFNI where it can
+static const char *oob_syndrome_tier_name( int tier )
+{
+    if( tier == OOB_CPU_SSE41 )
+        return "ssse3";
+#if defined(__x86_64__) || defined(__i386__)
+    if( tier == OOB_CPU_AVX512 && __builtin_cpu_supports("gfni") )
+        return "avx512 gfni";
+#endif
+
+
+    return oob_tier_names[tier];
+}
+
+
+// highest tier the CPU supports
+int oob_cpu_tier( void )
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if( __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl") )
+        return OOB_CPU_AVX512;
+    if( __builtin_cpu_supports("avx2") && __builtin_cpu_supports("gfni") )
+        return OOB_CPU_GFNI;
+    if( __builtin_cpu_supports("avx2") )
+        return OOB_CPU_AVX2;
+    if( __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3") )
+        return OOB_CPU_SSE41;
+#endif
+
+
+    return OOB_CPU_SCALAR;
+}
+
+
+const char *oob_cpu_tier_name( int tier )
+{
+    return tier >= 0 && tier < OOB_CPU_TIERS ? oob_tier_names[tier] : "unknown";
+}
+
+
+int oob_cpu_tier_parse( const char *name )
+{
+    int tier;
+
+
+    for( tier=0; tier<OOB_CPU_TIERS; tier++ )
+    {
+        if( !strcmp( name, oob_tier_names[tier] ) )
+            return tier;
+    }
+
+
+    return -1;
+}
+
+
+// use no kernels above this tier - must be called before the first oob_decoder_init()
+// return value: 0 if successful, negative value if the tier is unknown or the CPU doesn't support it
+int oob_kernels_force_tier( int tier )
+{
+    if( tier < 0 || tier >= OOB_CPU_TIERS || tier > oob_cpu_tier() )
+        return -1;
+
+    oob_tier_cap = tier;
+
+
+    return 0;
+}
+
+
+// print the tier and the variant each kernel ended up with
+void oob_kernels_report( FILE *f )
+{
+    fprintf( f, "CPU tier: %s\n", oob_tier_names[oob_cpu_tier()] );
+    if( oob_tier_cap < oob_cpu_tier() )
+        fprintf( f, "  kernels limited to: %s\n", oob_tier_names[oob_tier_cap] );
+    fprintf( f, "  sync scan:     %s\n", oob_sync_scan_variant );
+    fprintf( f, "  de-interleave: %s\n", oob_de_interleave_variant );
+    fprintf( f, "  frame (fused): %s\n", oob_de_frame_variant );
+    fprintf( f, "  derandomize:   %s\n", oob_xor_variant );
+    fprintf( f, "  syndromes:     %s\n", oob_syndrome_variant );
+}
+
+
+// a variant of this tier may be used - it is not above the forced tier, and the CPU has the feature
+#define OOB_USE( tier, feature )    ((tier) <= oob_tier_cap && __builtin_cpu_supports( feature ))
+
+
+void oob_kernels_init( void )
+{
+    int tier;
+
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if( OOB_USE( OOB_CPU_AVX512, "avx512bw" ) )
+    {
+        oob_sync_scan_kernel = oob_sync_scan_avx512;
+        oob_sync_scan_variant = "avx512";
+    }
+    else if( OOB_USE( OOB_CPU_AVX2, "avx2" ) )
+    {
+        oob_sync_scan_kernel = oob_sync_scan_avx2;
+        oob_sync_scan_variant = "avx2";
+    }
+    else if( OOB_USE( OOB_CPU_SSE41, "sse2" ) )
+    {
+        oob_sync_scan_kernel = oob_sync_scan_sse2;
+        oob_sync_scan_variant = "sse2";
+    }
+
+    if( OOB_USE( OOB_CPU_AVX512, "avx512bw" ) )
+    {
+        oob_xor_kernel = oob_xor_avx512;
+        oob_xor_variant = "avx512";
+    }
+    else if( OOB_USE( OOB_CPU_AVX2, "avx2" ) )
+    {
+        oob_xor_kernel = oob_xor_avx2;
+        oob_xor_variant = "avx2";
+    }
+    else if( OOB_USE( OOB_CPU_SSE41, "sse2" ) )
+    {
+        oob_xor_kernel = oob_xor_sse2;
+        oob_xor_variant = "sse2";
+    }
+
+    if( OOB_USE( OOB_CPU_AVX512, "avx512bw" ) && __builtin_cpu_supports("avx512vl") )
+    {
+        oob_de_interleave_frame_kernel = oob_de_interleave_frame_avx512;
+        oob_de_frame_kernel = oob_de_frame_avx512;
+        oob_de_interleave_variant = oob_de_frame_variant = "avx512";
+    }
+    else if( OOB_USE( OOB_CPU_AVX2, "avx2" ) )
+    {
+        oob_de_interleave_frame_kernel = oob_de_interleave_frame_avx2;
+        oob_de_frame_kernel = oob_de_frame_avx2;
+        oob_de_interleave_variant = oob_de_frame_variant = "avx2";
+    }
+    else if( OOB_USE( OOB_CPU_SSE41, "sse4.1" ) )
+    {
+        oob_de_interleave_frame_kernel = oob_de_interleave_frame_sse41;
+        oob_de_frame_kernel = oob_de_frame_sse41;
+        oob_de_interleave_variant = oob_de_frame_variant = "sse4.1";
+    }
+#endif
+
+    // the syndrome tables are built here rather than by the first decoder with FEC, so the kernels can be checked
+    // (initialize_ecc() leaves kernels that have been picked alone)
+    init_syndrome_tables();
+    tier = select_syndrome_kernels( oob_tier_cap );
+    oob_syndrome_variant = oob_syndrome_tier_name( tier );
+
+    if( oob_check_sync_scan( oob_sync_scan_kernel ) )
+    {
+        fprintf( stderr, "Sync scan kernel failed self-test - using scalar version.\n" );
+        oob_sync_scan_kernel = oob_sync_scan_scalar;
+        oob_sync_scan_variant = "scalar";
+    }
+
+    if( oob_check_xor( oob_xor_kernel ) )
+    {
+        fprintf( stderr, "XOR kernel failed self-test - using scalar version.\n" );
+        oob_xor_kernel = oob_xor_scalar;
+        oob_xor_variant = "scalar";
+    }
+
+    if( oob_check_de_interleave_frame( oob_de_interleave_frame_kernel ) )
+    {
+        fprintf( stderr, "De-interleave kernel failed self-test - using scalar version.\n" );
+        oob_de_interleave_frame_kernel = oob_de_interleave_frame_scalar;
+        oob_de_interleave_variant = "scalar";
+    }
+
+    if( oob_check_de_frame( oob_de_frame_kernel ) )
+    {
+        fprintf( stderr, "Frame kernel failed self-test - using scalar version.\n" );
+        oob_de_frame_kernel = oob_de_frame_scalar;
+        oob_de_frame_variant = "scalar";
+    }
+
+    if( oob_check_syndromes() )
+    {
+        fprintf( stderr, "Syndrome kernels failed self-test - using scalar version.\n" );
+        select_syndrome_kernels( SYN_TIER_NONE );
+        oob_syndrome_variant = "scalar";
+    }
+}
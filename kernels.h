@@ -0,0 +1,77 @@
+#ifndef _KERNELS_H
+#define _KERNELS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+
+//-----------------------------------------
+// Vectorized variants of the frame kernels
+//-----------------------------------------
+//
+// oob_kernels_init() picks the widest variant the CPU supports (cpuid, through __builtin_cpu_supports()) for each
+// kernel, checks it bit-exact against the scalar reference on a test vector, and falls back to the scalar reference
+// if the check fails - so one binary built without -march runs at its best on every generation of x86 it lands on
+// called once by oob_decoder_init() - this includes the RS syndrome kernels of rscode-1.3/syndrome.c
+//
+// the variants are grouped in tiers - a kernel uses the widest variant of any tier up to the CPU's (or the forced) tier
+// that the CPU supports, a kernel with no variant at that tier uses the next narrower one
+
+
+#define OOB_CPU_SCALAR          0           // portable C
+#define OOB_CPU_SSE41           1           // SSE2 / SSSE3 / SSE4.1
+#define OOB_CPU_AVX2            2
+#define OOB_CPU_GFNI            3           // AVX2 + GFNI (syndromes)
+#define OOB_CPU_AVX512          4           // AVX-512BW/VL - GFNI too, if the CPU has it
+#define OOB_CPU_TIERS           5
+
+// the tiers are numbered like the syndrome kernel tiers (SYN_TIER_...) so they can be passed straight on
+
+
+// 1. de-interleave all four 96-byte blocks of a frame - data_in[] must contain at least 1152 bytes, frame_out[] gets 384 bytes
+extern void (*oob_de_interleave_frame_kernel)( uint8_t *data_in, uint8_t *frame_out );
+
+// 1. + 3. + 4. de-interleave, derandomize and drop parity bytes of a frame - see oob_de_frame()
+extern void (*oob_de_frame_kernel)( uint8_t *data_in, uint8_t *ts_out );
+
+
+// 3. dst[i] = src[i] ^ key[i] for len bytes (any length) - dst may be the same buffer as src
+// used with oob_rand_mask[] / oob_rand_table[] by the derandomizer
+extern void (*oob_xor_kernel)( uint8_t *dst, const uint8_t *src, const uint8_t *key, int len );
+
+
+// 0. first i < n with data[i]==0x47 and data[i+192]==0x64 (a sync pair), n if there is none
+// data[] must contain at least n+192 bytes
+extern int (*oob_sync_scan_kernel)( uint8_t *data, int n );
+
+
+// scalar references (oobin.c / kernels.c)
+void oob_de_interleave_frame_scalar( uint8_t *data_in, uint8_t *frame_out );
+void oob_de_frame_scalar( uint8_t *data_in, uint8_t *ts_out );
+void oob_xor_scalar( uint8_t *dst, const uint8_t *src, const uint8_t *key, int len );
+int oob_sync_scan_scalar( uint8_t *data, int n );
+
+
+void oob_kernels_init( void );
+
+
+// highest tier the CPU supports
+int oob_cpu_tier( void );
+
+
+// name of a tier ("scalar", "sse4.1", "avx2", "gfni", "avx512"), and the tier of a name - negative value if unknown
+const char *oob_cpu_tier_name( int tier );
+int oob_cpu_tier_parse( const char *name );
+
+
+// use no kernels above this tier (for benchmarking the tiers against each other)
+// must be called before the first oob_decoder_init()
+// return value: 0 if successful, negative value if the tier is unknown or the CPU doesn't support it
+int oob_kernels_force_tier( int tier );
+
+
+// print the tier and the variant each kernel ended up with
+void oob_kernels_report( FILE *f );
+
+
+#endif  // _KERNELS_H
@@ -3,8 +3,76 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
 
 #include "oobin.h"
+#include "pipeline.h"
+#include "stream.h"
+#include "arena.h"
+#include "mmapio.h"
+#include "uring.h"
+#include "daemon.h"
+#include "kernels.h"
+#include "udpout.h"
+#include "metrics.h"
+
+
+// -P - print the per-stage profile every profile_interval seconds while decoding
+// the counters are read while the decoder is updating them, so these reports are approximate - the one at exit is exact
+// (in pipelined mode the workers' counters are only added in at exit)
+static int profile_interval;
+
+#ifdef OOB_PROFILE
+static void *profile_thread( void *arg )
+{
+    oob_decoder *dec = (oob_decoder *)arg;
+
+
+    for( ;; )
+    {
+        sleep( profile_interval );
+        oob_prof_report( stderr, &dec->prof );
+    }
+
+
+    return NULL;
+}
+#endif
+
+
+// -v - report sync lock / loss of lock on stderr
+static void sync_event( void *arg, int event, uint64_t stream_pos )
+{
+    fprintf( stderr, "%s at byte %llu\n", event == OOB_SYNC_EVENT_LOCK ? "Sync locked" : "Sync lost", (unsigned long long)stream_pos );
+}
+
+
+// write npackets TS packets to the output of their PID - pid_out[0] (the -w output) unless -p <pid>=<file> gave it its own
+// each run of packets going to the same output is written with one fwrite(), or handed to udp if the -w output is one
+// return value: 0 if successful, negative value if an output could not be written
+static int write_packets( FILE **pid_out, oob_udp_sink *udp, int nroutes, const oob_pid_filter *filter, const uint8_t *ts, int npackets )
+{
+    int route = 0;
+    int run;
+    int n;
+
+
+    for( n=0; n<npackets; n+=run )
+    {
+        run = nroutes > 1 ? oob_pid_route_run( filter, ts + n*188, npackets - n, &route ) : npackets;
+        if( route == 0 && udp )
+        {
+            if( oob_udp_write( udp, ts + n*188, run ) < 0 )
+                return -1;
+        }
+        else if( (int)fwrite( ts + n*188, 188, run, pid_out[route] ) < run )
+            return -1;
+    }
+
+
+    return 0;
+}
 
 
 int main( int argc, char **argv)
@@ -12,20 +80,54 @@ int main( int argc, char **argv)
     int opt;                            // for command-line parsing
     char in_filename[FILENAME_MAX] = "-";
     char out_filename[FILENAME_MAX] = "-";
+    char flags_filename[FILENAME_MAX] = "";
     FILE *InFile;
-    FILE *OutFile;
-    uint8_t *InData;
-    uint8_t *OutData;
-    int OutDataLen;                     // # of bytes placed in OutData[] by process_data_chunk()
+    FILE *OutFile = NULL;
+    oob_udp_sink udp;                   // -w udp:// or rtp:// - TS packets sent as datagrams instead of written to OutFile
+    int use_udp = 0;
+    int udp_sndbuf = 0;                 // -U - socket send buffer size, 0 = the system default
+    FILE *FlagsFile = NULL;             // -E - erasure flags, one byte for each byte of the input bitstream
+    uint8_t *InData;                    // where the next read goes in the stream's ring buffer
+    int InDataLen;                      // # of bytes that fit there
+    oob_arena OutArena;                 // OutData[] - cache line aligned, on huge pages if it is large enough
+    uint8_t *OutData = NULL;
+    int npackets;                       // # of TS packets placed in OutData[] by oob_stream_read_packets()
     int BytesRead;
-    int BytesWritten;
-    int BytesRemaining = 0;             // # of bytes remaining in InData[] after process_data_chunk() completed
+    int FlagsRead;
     int blocks_per_chunk = 100;         // how many 768-byte blocks to read from the file and process in each chunk
     int do_fec = 0;
+    int threads = 0;                    // # of decode threads in pipelined mode, 0 = single-threaded read/decode/write loop
+    int queue_depth = 4;                // # of chunks in flight per decode thread in pipelined mode
+    int frame_threads = 1;              // # of threads decoding the frames of each chunk in parallel
+    int lock_syncs = OOB_SYNC_LOCK_SYNCS;       // # of good syncs in a row to lock, 0 = search for sync before every frame
+    int unlock_misses = OOB_SYNC_UNLOCK_MISSES; // # of missed syncs in a row to lose lock
+    int verbose = 0;
+    int profile = 0;
+    char **streams = NULL;              // -S - daemon mode, "<input>=<output>" for each stream
+    int nstreams = 0;
+    oob_pid_filter pid_filter;          // -p - the PIDs decoded, and which output each goes to
+    int npids = 0;
+    char *pid_files[OOB_PID_MAX_ROUTES] = { NULL };    // -p <pid>=<file> - the file of each output, [0] is the -w output
+    FILE *pid_out[OOB_PID_MAX_ROUTES] = { NULL };
+    int nroutes = 1;
+    int pid;
+    int route;
+    char *end;
+    char metrics_target[FILENAME_MAX] = "";    // -M - where the decoder statistics are exported while decoding
+    int metrics_interval = OOB_METRICS_INTERVAL;
+    oob_metrics metrics;
+    int use_metrics = 0;
+    int cpu_tier = -1;                  // -C - kernel tier forced for benchmarking, -1 = the best the CPU has
+    char input_mode[16] = "auto";       // how the input file is read - "auto" = mmap for regular files, stdio otherwise, "uring" = io_uring in and out
+    int ret;
+    oob_decoder decoder;
+    oob_stream stream;
         
     
+    oob_pid_filter_init( &pid_filter );
+
 // parse command-line arguments (argv)                                                
-    while( (opt = getopt(argc, argv, "hf:w:b:e")) != -1 )
+    while( (opt = getopt(argc, argv, "hf:w:b:et:q:j:s:m:vi:P:E:S:p:C:U:M:I:")) != -1 )
     {
         switch (opt) 
         {
@@ -34,8 +136,27 @@ int main( int argc, char **argv)
             printf( "%s %s\n\n", _SOFT_NAME_, _SOFT_VER_ );   // _SOFT_NAME_ and _SOFT_VER_ are DEFS in Makefile
             printf( "f <filename> input filename - use \"-\" for stdin - default: \"%s\"\n", in_filename );
             printf( "w <outfile>  output filename (will be overwritten) - default: \"%s\"\n", out_filename );
+            printf( "             or udp://<host>:<port> to send %d TS packets per datagram, rtp://<host>:<port> with RTP headers\n", OOB_UDP_PACKETS );
+            printf( "U <bytes>    udp:// / rtp:// output - socket send buffer size (default: the system's)\n" );
             printf( "b <n>        number of 768-byte blocks to read in each chunk (default: %d)\n", blocks_per_chunk );
             printf( "e            error recovery - enable FEC check and repair\n" );
+            printf( "E <filename> erasure flags from the demodulator for -e - one byte for each input byte, non-zero = low confidence\n" );
+            printf( "t <n>        pipelined mode - reader thread, n decode threads and writer thread (default: %d = single-threaded)\n", threads );
+            printf( "q <n>        pipelined mode - number of chunks in flight per decode thread, io_uring - reads / writes in flight (default: %d)\n", queue_depth );
+            printf( "j <n>        number of threads decoding the frames of each chunk in parallel (default: %d)\n", frame_threads );
+            printf( "s <n>        sync - number of good syncs in a row to lock, 0 = never lock (default: %d)\n", lock_syncs );
+            printf( "m <n>        sync - number of missed syncs in a row to lose lock (default: %d)\n", unlock_misses );
+            printf( "v            verbose - report sync lock / loss and sync statistics\n" );
+            printf( "P <n>        print a per-stage profile at exit, and every n seconds while decoding if n > 0 (needs make PROFILE=1)\n" );
+            printf( "S <in>=<out> daemon mode - decode this stream too (repeat -S for each), -t sets the # of worker threads for all of them\n" );
+            printf( "             in: file, FIFO, unix:<socket path> or - for stdin, out: file, FIFO, udp:// or rtp:// like -w, or - for stdout\n" );
+            printf( "p <pid>      only output TS packets with this PID (repeat -p for each) - decimal or 0x hex\n" );
+            printf( "p <pid>=<file> output the packets with this PID to <file> instead (stdio input, not in pipelined or daemon mode)\n" );
+            printf( "M <target>   export decoder metrics while decoding - to a file rewritten every interval, or unix:<socket path> to\n" );
+            printf( "             serve them to each client that connects - Prometheus text format, JSON if the name ends in .json\n" );
+            printf( "I <n>        metrics - seconds between snapshots (default: %d)\n", metrics_interval );
+            printf( "C <tier>     limit the vector kernels to a tier - scalar, sse4.1, avx2, gfni or avx512 (default: %s, the CPU's)\n", oob_cpu_tier_name( oob_cpu_tier() ) );
+            printf( "i <mode>     I/O method - auto, stdio, mmap (regular input files only) or uring (io_uring for input and output) (default: \"%s\")\n", input_mode );
             printf( "\n" );
             return 1;
 
@@ -54,6 +175,98 @@ int main( int argc, char **argv)
           case 'e':
             do_fec = 1;
             break;
+
+          case 'E':
+            strncpy( flags_filename, optarg, sizeof(flags_filename)-1 );
+            break;
+
+          case 't':
+            threads = strtoul( optarg, NULL, 0 );
+            break;
+
+          case 'q':
+            queue_depth = strtoul( optarg, NULL, 0 );
+            break;
+
+          case 'j':
+            frame_threads = strtoul( optarg, NULL, 0 );
+            break;
+
+          case 's':
+            lock_syncs = strtoul( optarg, NULL, 0 );
+            break;
+
+          case 'm':
+            unlock_misses = strtoul( optarg, NULL, 0 );
+            break;
+
+          case 'v':
+            verbose = 1;
+            break;
+
+          case 'P':
+            profile = 1;
+            profile_interval = strtoul( optarg, NULL, 0 );
+            break;
+
+          case 'S':
+            streams = (char **)realloc( streams, (nstreams + 1) * sizeof(char *) );
+            if( !streams )
+            {
+                printf( "Error - unable to allocate stream list - aborting.\n" );
+                return 1;
+            }
+            streams[nstreams++] = optarg;
+            break;
+
+          case 'i':
+            strncpy( input_mode, optarg, sizeof(input_mode)-1 );
+            break;
+
+          case 'M':
+            strncpy( metrics_target, optarg, sizeof(metrics_target)-1 );
+            break;
+
+          case 'I':
+            metrics_interval = strtoul( optarg, NULL, 0 );
+            break;
+
+          case 'C':
+            cpu_tier = oob_cpu_tier_parse( optarg );
+            if( cpu_tier < 0 )
+            {
+                printf( "Error - unknown kernel tier '%s' - aborting.\n", optarg );
+                return 1;
+            }
+            break;
+
+          case 'U':
+            udp_sndbuf = strtoul( optarg, NULL, 0 );
+            break;
+
+          case 'p':
+            pid = strtoul( optarg, &end, 0 );
+            if( end == optarg || (*end && *end != '=') || pid >= OOB_PID_COUNT )
+            {
+                printf( "Error - '%s' is not a PID (0 - %d) - aborting.\n", optarg, OOB_PID_COUNT-1 );
+                return 1;
+            }
+            route = 0;
+            if( *end == '=' )
+            {   // PIDs given the same file share one output
+                for( route=1; route<nroutes && strcmp( pid_files[route], end+1 ); route++ )
+                    ;
+                if( route == OOB_PID_MAX_ROUTES )
+                {
+                    printf( "Error - too many PID output files (%d max) - aborting.\n", OOB_PID_MAX_ROUTES-1 );
+                    return 1;
+                }
+                if( route == nroutes )
+                    pid_files[nroutes++] = end+1;
+            }
+            oob_pid_filter_add( &pid_filter, pid, route );
+            npids++;
+            break;
         }  
     }
 
@@ -83,80 +296,279 @@ int main( int argc, char **argv)
         return 2;
     }
 
-    
-    // malloc() space for input data - 768 bytes each block = 2 TS packets (188 bytes) + 4 FEC parity bytes
-    InData = (uint8_t *)malloc( blocks_per_chunk * 768 );
-    if( !InData )
+
+    if( strlen(flags_filename) )
     {
-        printf( "Error - unable to malloc(%d) InData - aborting.\n", blocks_per_chunk * 768 );
-        goto end_no_free;
+        FlagsFile = fopen( flags_filename, "rb" );
+        if( !FlagsFile )
+        {
+            printf( "Error - unable to open erasure flags file '%s' - aborting.\n", flags_filename );
+            fclose( InFile );
+            return 2;
+        }
+
+        // the flags are read in step with the input, through the stream
+        if( threads > 0 || strcmp( input_mode, "auto" ) )
+            fprintf( stderr, "Erasure flags are only read with stdio input - decoding single-threaded with stdio.\n" );
+        threads = 0;
+        strcpy( input_mode, "stdio" );
     }
+
+    if( nroutes > 1 )
+    {
+        if( nstreams > 0 )
+        {
+            printf( "Error - PID output files can't be used in daemon mode - aborting.\n" );
+            goto end_no_free;
+        }
+
+        // the packets are split between the outputs as they are written, by the stdio loop
+        if( threads > 0 || strcmp( input_mode, "auto" ) )
+            fprintf( stderr, "PID output files are only written with stdio input - decoding single-threaded with stdio.\n" );
+        threads = 0;
+        strcpy( input_mode, "stdio" );
+    }
+
+    if( oob_udp_is_url( out_filename ) && nstreams == 0 )
+    {
+        // the datagrams are sent as the packets are written, by the stdio loop
+        if( threads > 0 || strcmp( input_mode, "auto" ) )
+            fprintf( stderr, "UDP output is only sent with stdio input - decoding single-threaded with stdio.\n" );
+        threads = 0;
+        strcpy( input_mode, "stdio" );
+        use_udp = 1;
+    }
+
     
     // malloc() space for output data - each TS packet is 188 bytes (8 bytes FEC parity from 2 TS packets removed before being placed in OutData)
-    OutData = (uint8_t *)malloc( blocks_per_chunk * 752 );
+    if( oob_arena_alloc( &OutArena, blocks_per_chunk * 752 ) == 0 )
+        OutData = OutArena.base;
     if( !OutData )
     {
         printf( "Error - unable to malloc(%d) OutData - aborting.\n", blocks_per_chunk * 752 );
-        goto end_free_indata;
+        goto end_no_free;
     }
 
-    // open output file that we will write TS output to
-    if( !strcmp( out_filename, "-" ) )
+    // open output file that we will write TS output to, or the socket we send it on
+    if( use_udp )
+    {
+        if( oob_udp_open( &udp, out_filename, udp_sndbuf ) < 0 )
+        {
+            printf( "Error - unable to open UDP output '%s' - %s - aborting.\n", out_filename, strerror( errno ) );
+            goto end_free_outdata;
+        }
+        if( verbose )
+            fprintf( stderr, "UDP output socket send buffer: %d bytes\n", oob_udp_sndbuf( &udp ) );
+    }
+    else if( !strcmp( out_filename, "-" ) )
         OutFile = stdout;
     else
         OutFile = fopen( out_filename, "wb" );
-    if( !OutFile )
+    if( !OutFile && !use_udp )
     {
         printf( "Error - unable to open output file '%s' - aborting.\n", out_filename );
         goto end_free_outdata;
     }
 
+    pid_out[0] = OutFile;
+    for( route=1; route<nroutes; route++ )
+    {
+        pid_out[route] = fopen( pid_files[route], "wb" );
+        if( !pid_out[route] )
+        {
+            printf( "Error - unable to open PID output file '%s' - aborting.\n", pid_files[route] );
+            goto end_close_pid_out;
+        }
+    }
+
 
     // the 384-byte rand_table[] used for TS randomization can be calculated now, if the table wasn't precalculated and included at compile time
     // in this case it is not necessary because oobin.c contains a precalculated rand_table[]
 //    oob_calc_rand_table( rand_table );
     
 
+    // before the first decoder picks the kernels
+    if( cpu_tier >= 0 && oob_kernels_force_tier( cpu_tier ) < 0 )
+        fprintf( stderr, "This CPU doesn't support the %s kernels - using the best it has.\n", oob_cpu_tier_name( cpu_tier ) );
+
+    oob_decoder_init( &decoder, do_fec );
+    if( verbose )
+        oob_kernels_report( stderr );
+    decoder.sync.lock_syncs = lock_syncs;
+    decoder.sync.unlock_misses = unlock_misses;
+    if( verbose )
+        decoder.sync.event = sync_event;
+    if( npids > 0 )
+        decoder.pid_filter = &pid_filter;
+
+    // the daemon adds each of its streams' decoders, everything else decodes with this one (and merges into it)
+    if( strlen(metrics_target) )
+    {
+        if( oob_metrics_start( &metrics, metrics_target, metrics_interval ) < 0 )
+            fprintf( stderr, "Unable to export metrics to '%s' - %s\n", metrics_target, strerror( errno ) );
+        else
+        {
+            use_metrics = 1;
+            if( nstreams == 0 )
+                oob_metrics_add( &metrics, "", &decoder );
+        }
+    }
+
+#ifdef OOB_PROFILE
+    if( profile && profile_interval > 0 )
+    {
+        pthread_t profiler;
+
+        if( !pthread_create( &profiler, NULL, profile_thread, &decoder ) )
+            pthread_detach( profiler );
+    }
+#endif
+
+
+    // daemon mode - all -S streams decoded by one pool of worker threads, each stream with its own decoder like this one
+    if( nstreams > 0 )
+    {
+        if( threads <= 0 )
+            threads = sysconf( _SC_NPROCESSORS_ONLN ) > 0 ? sysconf( _SC_NPROCESSORS_ONLN ) : 1;
+        if( oob_daemon_run( streams, nstreams, threads, blocks_per_chunk * 768, udp_sndbuf, use_metrics ? &metrics : NULL, &decoder, verbose ) < 0 )
+            fprintf( stderr, "Error in daemon mode - not every stream was decoded.\n" );
+        goto end_close_all;
+    }
+
+
+    // pipelined mode - reading, decoding and writing overlap on separate threads
+    // OutData[] is not used, the pipeline has its own chunk buffers
+    if( threads > 0 )
+    {
+        if( oob_pipeline_run( InFile, OutFile, blocks_per_chunk * 768, threads, queue_depth, frame_threads, &decoder ) < 0 )
+            fprintf( stderr, "Error in pipelined decode - aborting.\n" );
+        else if( do_fec )
+            fprintf( stderr, "Processed FEC blocks: %llu, errors: %llu, corrected: %llu\n", (unsigned long long)decoder.fec_total_block_count, (unsigned long long)decoder.fec_error_count, (unsigned long long)decoder.fec_corrected_block_count );
+        goto end_stats;
+    }
+
+    if( oob_decoder_set_threads( &decoder, frame_threads ) < 0 )
+        fprintf( stderr, "Unable to start %d frame decoding threads - decoding serially.\n", frame_threads );
+
+
+    // io_uring - reads queued ahead of the decoder and writes in flight behind it, falls back to stdio if the kernel lacks it
+    if( !strcmp( input_mode, "uring" ) )
+    {
+        fflush( OutFile );
+        ret = oob_uring_run( fileno(InFile), fileno(OutFile), blocks_per_chunk * 768, queue_depth, &decoder );
+        if( ret == 0 )
+            goto end_fec_stats;
+        if( ret < -1 )
+            goto end_stats;
+        fprintf( stderr, "io_uring is not available - using stdio instead.\n" );
+    }
+    // a regular file is decoded straight from a memory mapping of it
+    else if( strcmp( input_mode, "stdio" ) )
+    {
+        ret = oob_mmap_run( fileno(InFile), OutFile, blocks_per_chunk * 768, &decoder );
+        if( ret == 0 )
+            goto end_fec_stats;
+        if( ret < -1 )
+            goto end_stats;
+        if( !strcmp( input_mode, "mmap" ) )
+            fprintf( stderr, "Unable to mmap input file '%s' - reading it instead.\n", in_filename );
+    }
+
+
+    // input is read straight into the stream's ring buffer - 768 bytes each block = 2 TS packets (188 bytes) + 4 FEC parity bytes
+    if( oob_stream_init( &stream, &decoder, blocks_per_chunk * 768 ) < 0 )
+    {
+        fprintf( stderr, "Error - unable to allocate %d byte stream buffer - aborting.\n", blocks_per_chunk * 768 );
+        goto end_close_all;
+    }
+    if( FlagsFile && oob_stream_enable_erasures( &stream ) < 0 )
+    {
+        fprintf( stderr, "Error - unable to allocate the erasure flags buffer - aborting.\n" );
+        goto end_stream_free;
+    }
+
+
     // process entire InFile and write output to OutFile
     while( !feof(InFile) && !ferror(InFile) )
     {
         // read a chunk of data from input file
-        BytesRead = fread( InData+BytesRemaining, 1, blocks_per_chunk * 768 - BytesRemaining, InFile );
+        OOB_PROF_START( t );
+        InData = oob_stream_write_ptr( &stream, &InDataLen );
+        BytesRead = fread( InData, 1, InDataLen, InFile );
         if( BytesRead < 1 )
-            goto end_close_all;
-     
-        // return value: 0 or positive value if successful, return value is number of bytes remaining *data that have not been processed
-        // return value is negative in case of error
-        BytesRemaining = oob_process_data_chunk( InData, BytesRead+BytesRemaining, OutData, &OutDataLen, do_fec );
-        if( BytesRemaining < 0 )
-        {
-            fprintf( stderr, "Error %d in process_data_chunk() - aborting.\n", BytesRemaining );
             break;
+        if( FlagsFile )
+        {   // the same # of bytes of flags - past the end of the flags file every byte is taken as reliable
+            FlagsRead = fread( oob_stream_flags_ptr( &stream ), 1, BytesRead, FlagsFile );
+            if( FlagsRead < BytesRead )
+                memset( oob_stream_flags_ptr( &stream ) + FlagsRead, 0, BytesRead - FlagsRead );
         }
-        
-        if( OutDataLen > 0 )
+        oob_stream_commit( &stream, BytesRead );
+        OOB_PROF_LAP( &decoder.prof, OOB_PROF_READ, t, BytesRead );
+
+        // write out every TS packet the data read so far completes
+        while( (npackets = oob_stream_read_packets( &stream, OutData, blocks_per_chunk * 4 )) > 0 )
         {
-            BytesWritten = fwrite( OutData, 1, OutDataLen, OutFile );
-            if( BytesWritten < OutDataLen )
+            OOB_PROF_RESET( t );
+            ret = write_packets( pid_out, use_udp ? &udp : NULL, nroutes, &pid_filter, OutData, npackets );
+            OOB_PROF_LAP( &decoder.prof, OOB_PROF_WRITE, t, npackets * 188 );
+            if( ret < 0 )
             {
-                fprintf( stderr, "Error writing output file - %d / %d bytes written.\n", BytesWritten, OutDataLen );
-                break;
+                fprintf( stderr, "Error writing output file - aborting.\n" );
+                goto end_stream_free;
             }
-        }    
+        }
     }
 
+end_stream_free:
+    oob_stream_free( &stream );
+
+end_fec_stats:
     if( do_fec )
-        fprintf( stderr, "Processed FEC blocks: %d, errors: %d, corrected: %d\n", fec_total_block_count, fec_error_count, fec_corrected_block_count );
+        fprintf( stderr, "Processed FEC blocks: %llu, errors: %llu, corrected: %llu\n", (unsigned long long)decoder.fec_total_block_count, (unsigned long long)decoder.fec_error_count, (unsigned long long)decoder.fec_corrected_block_count );
+    if( do_fec && FlagsFile )
+        fprintf( stderr, "Blocks corrected with erasures: %llu, left uncorrected as ambiguous: %llu\n", (unsigned long long)decoder.fec_erasure_block_count, (unsigned long long)decoder.fec_ambiguous_block_count );
+
 
+end_stats:
+    if( verbose )
+        fprintf( stderr, "Sync locked: %llu, lost: %llu, flywheeled frames: %llu\n", (unsigned long long)decoder.sync.lock_count, (unsigned long long)decoder.sync.loss_count, (unsigned long long)decoder.sync.flywheel_count );
+    if( verbose )
+        fprintf( stderr, "Bytes in: %llu, frames decoded: %llu, TS packets out: %llu, with TEI set: %llu\n", (unsigned long long)decoder.in_byte_count, (unsigned long long)decoder.frame_count, (unsigned long long)decoder.out_packet_count, (unsigned long long)decoder.tei_packet_count );
+    if( verbose && npids > 0 )
+        fprintf( stderr, "TS packets dropped by the PID filter: %llu\n", (unsigned long long)decoder.pid_dropped_count );
+    if( use_udp && oob_udp_close( &udp ) < 0 )
+        fprintf( stderr, "Error sending the last UDP datagram - %s\n", strerror( errno ) );
+    if( verbose && use_udp )
+        fprintf( stderr, "UDP datagrams sent: %llu, refused by the destination: %llu\n", (unsigned long long)udp.datagrams, (unsigned long long)udp.refused );
+
+    if( profile )
+    {
+#ifdef OOB_PROFILE
+        oob_prof_report( stderr, &decoder.prof );
+#else
+        oob_prof_report( stderr, NULL );
+#endif
+    }
 
 end_close_all:
-    fclose( OutFile );
+    if( use_metrics )
+        oob_metrics_stop( &metrics );
+    oob_decoder_free( &decoder );
+end_close_pid_out:
+    for( route=1; route<nroutes && pid_out[route]; route++ )
+        fclose( pid_out[route] );
+    if( use_udp )
+        oob_udp_close( &udp );
+    else
+        fclose( OutFile );
 end_free_outdata:
-    free( OutData );
-end_free_indata:
-    free( InData );
+    oob_arena_free( &OutArena );
 end_no_free:    
+    if( FlagsFile )
+        fclose( FlagsFile );
     fclose( InFile );
+    free( streams );
     
     
     return 0;
@@ -0,0 +1,476 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+
+
+typedef struct oob_metric_def
+{
+    const char *name;                   // Prometheus name - the JSON key is the same without "oob_"
+    const char *type;
+    const char *help;
+    int ofs;                            // of the value in oob_metrics_counters
+} oob_metric_def;
+
+
+#define OOB_METRIC( name, type, field, help )   { name, type, help, offsetof(oob_metrics_counters, field) }
+
+static const oob_metric_def oob_metric_defs[] =
+{
+    OOB_METRIC( "oob_input_bytes_total",                    "counter", in_bytes,                 "Bitstream bytes taken in" ),
+    OOB_METRIC( "oob_output_bytes_total",                   "counter", out_bytes,                "TS bytes output" ),
+    OOB_METRIC( "oob_output_packets_total",                 "counter", out_packets,              "TS packets output, after the PID filter" ),
+    OOB_METRIC( "oob_frames_total",                         "counter", frames,                   "384-byte frames decoded" ),
+    OOB_METRIC( "oob_sync_locked",                          "gauge",   sync_locked,              "1 while the frame sync is locked" ),
+    OOB_METRIC( "oob_sync_locks_total",                     "counter", sync_locks,               "Times the frame sync locked" ),
+    OOB_METRIC( "oob_sync_losses_total",                    "counter", sync_losses,              "Times the frame sync was lost" ),
+    OOB_METRIC( "oob_sync_flywheel_frames_total",           "counter", flywheel_frames,          "Frames decoded without a valid sync pair while locked" ),
+    OOB_METRIC( "oob_fec_blocks_total",                     "counter", fec_blocks,               "96-byte FEC blocks checked" ),
+    OOB_METRIC( "oob_fec_error_blocks_total",               "counter", fec_error_blocks,         "FEC blocks with errors" ),
+    OOB_METRIC( "oob_fec_corrected_blocks_total",           "counter", fec_corrected_blocks,     "FEC blocks corrected" ),
+    OOB_METRIC( "oob_fec_erasure_corrected_blocks_total",   "counter", fec_erasure_blocks,       "FEC blocks corrected with the erasure flags" ),
+    OOB_METRIC( "oob_fec_erasure_ambiguous_blocks_total",   "counter", fec_ambiguous_blocks,     "FEC blocks with 2 erasures not corrected, as they also fit a single unflagged error" ),
+    OOB_METRIC( "oob_fec_uncorrectable_blocks_total",       "counter", fec_uncorrectable_blocks, "FEC blocks with errors that could not be corrected" ),
+    OOB_METRIC( "oob_tei_packets_total",                    "counter", tei_packets,              "TS packets decoded with the transport error indicator set" ),
+    OOB_METRIC( "oob_pid_dropped_packets_total",            "counter", pid_dropped_packets,      "TS packets dropped by the PID filter" ),
+    OOB_METRIC( "oob_input_bytes_per_second",               "gauge",   in_bytes_per_second,      "Bitstream bytes taken in per second, over the last interval" ),
+    OOB_METRIC( "oob_output_bytes_per_second",              "gauge",   out_bytes_per_second,     "TS bytes output per second, over the last interval" ),
+};
+
+#define OOB_METRIC_DEFS         (int)(sizeof(oob_metric_defs) / sizeof(oob_metric_defs[0]))
+
+
+static double oob_metrics_now( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+#define OOB_READ( x )           __atomic_load_n( &(x), __ATOMIC_RELAXED )
+
+// read the counters of dec while its decoding thread(s) may be updating them
+static void oob_metrics_read( const oob_decoder *dec, oob_metrics_counters *c )
+{
+    c->in_bytes = OOB_READ( dec->in_byte_count );
+    c->out_packets = OOB_READ( dec->out_packet_count );
+    c->frames = OOB_READ( dec->frame_count );
+    c->sync_locks = OOB_READ( dec->sync.lock_count );
+    c->sync_losses = OOB_READ( dec->sync.loss_count );
+    c->flywheel_frames = OOB_READ( dec->sync.flywheel_count );
+    c->fec_blocks = OOB_READ( dec->fec_total_block_count );
+    c->fec_error_blocks = OOB_READ( dec->fec_error_count );
+    c->fec_corrected_blocks = OOB_READ( dec->fec_corrected_block_count );
+    c->fec_erasure_blocks = OOB_READ( dec->fec_erasure_block_count );
+    c->fec_ambiguous_blocks = OOB_READ( dec->fec_ambiguous_block_count );
+    c->tei_packets = OOB_READ( dec->tei_packet_count );
+    c->pid_dropped_packets = OOB_READ( dec->pid_dropped_count );
+    c->sync_locked = OOB_READ( dec->sync.state ) == OOB_SYNC_LOCKED;
+
+    c->out_bytes = c->out_packets * 188;
+    // read one after the other - don't let a correction counted in between make it go negative
+    c->fec_uncorrectable_blocks = c->fec_error_blocks > c->fec_corrected_blocks ? c->fec_error_blocks - c->fec_corrected_blocks : 0;
+}
+
+
+// read the counters of every source - and work out the throughput since the last time if rates is set
+static void oob_metrics_snapshot( oob_metrics *m, int rates )
+{
+    oob_metrics_source *src;
+    double now = oob_metrics_now();
+    double dt = now - m->rate_time;
+    int n;
+
+
+    pthread_mutex_lock( &m->lock );
+    for( n=0; n<m->nsources; n++ )
+    {
+        src = &m->sources[n];
+        if( src->dec )
+            oob_metrics_read( src->dec, &src->counters );
+
+        if( rates && dt > 0 )
+        {
+            src->counters.in_bytes_per_second = (src->counters.in_bytes - src->rate_in_bytes) / dt + 0.5;
+            src->counters.out_bytes_per_second = (src->counters.out_bytes - src->rate_out_bytes) / dt + 0.5;
+            src->rate_in_bytes = src->counters.in_bytes;
+            src->rate_out_bytes = src->counters.out_bytes;
+        }
+    }
+    if( rates )
+        m->rate_time = now;
+    pthread_mutex_unlock( &m->lock );
+}
+
+
+static void oob_metrics_print_name( FILE *f, const char *name, int json )
+{
+    for( ; *name; name++ )
+    {
+        if( *name == '\\' || *name == '"' )
+            fprintf( f, "\\%c", *name );
+        else if( *name == '\n' )
+            fprintf( f, "\\n" );
+        else if( json && (unsigned char)*name < 0x20 )
+            fprintf( f, "\\u%04x", *name );
+        else
+            fputc( *name, f );
+    }
+}
+
+
+#define OOB_METRIC_VALUE( src, def )    (unsigned long long)*(const uint64_t *)((const char *)&(src)->counters + (def)->ofs)
+
+// Prometheus text format - one HELP / TYPE block per metric, a line for each source in it
+static void oob_metrics_print_prometheus( FILE *f, oob_metrics *m )
+{
+    const oob_metric_def *def;
+    oob_metrics_source *src;
+    int k, n;
+
+
+    for( k=0; k<OOB_METRIC_DEFS; k++ )
+    {
+        def = &oob_metric_defs[k];
+        fprintf( f, "# HELP %s %s\n# TYPE %s %s\n", def->name, def->help, def->name, def->type );
+
+        for( n=0; n<m->nsources; n++ )
+        {
+            src = &m->sources[n];
+            fprintf( f, "%s", def->name );
+            if( src->name[0] )
+            {
+                fprintf( f, "{stream=\"" );
+                oob_metrics_print_name( f, src->name, 0 );
+                fprintf( f, "\"}" );
+            }
+            fprintf( f, " %llu\n", OOB_METRIC_VALUE( src, def ) );
+        }
+    }
+
+    fprintf( f, "# HELP oob_uptime_seconds Seconds since the metrics export started\n# TYPE oob_uptime_seconds gauge\n" );
+    fprintf( f, "oob_uptime_seconds %.0f\n", oob_metrics_now() - m->start_time );
+}
+
+
+// JSON - { "timestamp": ..., "uptime_seconds": ..., "streams": [ { "stream": "<name>", "input_bytes_total": ..., ... } ] }
+static void oob_metrics_print_json( FILE *f, oob_metrics *m )
+{
+    oob_metrics_source *src;
+    int k, n;
+
+
+    fprintf( f, "{\n  \"timestamp\": %lld,\n  \"uptime_seconds\": %.0f,\n  \"streams\": [", (long long)time( NULL ), oob_metrics_now() - m->start_time );
+
+    for( n=0; n<m->nsources; n++ )
+    {
+        src = &m->sources[n];
+        fprintf( f, "%s\n    {\n      \"stream\": \"", n ? "," : "" );
+        oob_metrics_print_name( f, src->name, 1 );
+        fprintf( f, "\"" );
+
+        for( k=0; k<OOB_METRIC_DEFS; k++ )
+            fprintf( f, ",\n      \"%s\": %llu", oob_metric_defs[k].name + 4, OOB_METRIC_VALUE( src, &oob_metric_defs[k] ) );
+        fprintf( f, "\n    }" );
+    }
+
+    fprintf( f, "\n  ]\n}\n" );
+}
+
+
+static void oob_metrics_print( FILE *f, oob_metrics *m )
+{
+    pthread_mutex_lock( &m->lock );
+    if( m->json )
+        oob_metrics_print_json( f, m );
+    else
+        oob_metrics_print_prometheus( f, m );
+    pthread_mutex_unlock( &m->lock );
+}
+
+
+// write the last snapshot to <target>.tmp, then rename it over <target>
+static void oob_metrics_write_file( oob_metrics *m )
+{
+    char tmp[FILENAME_MAX + 8];
+    FILE *f;
+
+
+    snprintf( tmp, sizeof(tmp), "%s.tmp", m->target );
+    f = fopen( tmp, "w" );
+    if( !f )
+        return;
+
+    oob_metrics_print( f, m );
+
+    if( fclose( f ) == 0 )
+        rename( tmp, m->target );
+    else
+        unlink( tmp );
+}
+
+
+// send the current counters to a client that connected to the socket, and hang up
+static void oob_metrics_serve( oob_metrics *m )
+{
+    struct timeval timeout = { 1, 0 };
+    char *buf = NULL;
+    size_t len = 0;
+    size_t sent;
+    FILE *f;
+    int fd;
+    int n;
+
+
+    fd = accept( m->listen_fd, NULL, NULL );
+    if( fd < 0 )
+        return;
+
+    // a client that doesn't read can hold the exporter up for a second at most
+    setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout) );
+
+    oob_metrics_snapshot( m, 0 );
+    f = open_memstream( &buf, &len );
+    if( f )
+    {
+        oob_metrics_print( f, m );
+        fclose( f );
+
+        // MSG_NOSIGNAL - a client that has hung up already (a connect-only health check) gets EPIPE, not the decoder SIGPIPE
+        for( sent=0; sent<len; sent+=n )
+        {
+            n = send( fd, buf + sent, len - sent, MSG_NOSIGNAL );
+            if( n == 0 || (n < 0 && errno != EINTR) )
+                break;
+            if( n < 0 )
+                n = 0;
+        }
+        free( buf );
+    }
+
+    close( fd );
+}
+
+
+static void *oob_metrics_thread( void *arg )
+{
+    oob_metrics *m = (oob_metrics *)arg;
+    struct pollfd pfd[2];
+    int nfds = 1;
+    double next = oob_metrics_now() + m->interval;
+    double now;
+    int timeout;
+
+
+    pfd[0].fd = m->stop_fd;
+    pfd[0].events = POLLIN;
+    if( m->listen_fd >= 0 )
+    {
+        pfd[1].fd = m->listen_fd;
+        pfd[1].events = POLLIN;
+        nfds = 2;
+    }
+
+    for( ;; )
+    {
+        now = oob_metrics_now();
+        if( now >= next )
+        {
+            oob_metrics_snapshot( m, 1 );
+            if( m->listen_fd < 0 )
+                oob_metrics_write_file( m );
+            next += m->interval;
+            if( next <= now )
+                next = now + m->interval;
+        }
+
+        timeout = (int)((next - now) * 1000) + 1;
+        if( poll( pfd, nfds, timeout ) < 0 && errno != EINTR )
+            break;
+        if( pfd[0].revents )
+            break;                      // oob_metrics_stop()
+        if( nfds > 1 && (pfd[1].revents & POLLIN) )
+            oob_metrics_serve( m );
+    }
+
+
+    return NULL;
+}
+
+
+// listen on the UNIX stream socket at path - a socket left behind by an earlier run is replaced
+static int oob_metrics_listen( const char *path )
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+
+    if( strlen( path ) >= sizeof(addr.sun_path) )
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset( &addr, 0, sizeof(addr) );
+    addr.sun_family = AF_UNIX;
+    strcpy( addr.sun_path, path );
+
+    if( stat( path, &st ) == 0 && S_ISSOCK( st.st_mode ) )
+        unlink( path );
+
+    fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( fd < 0 )
+        return -1;
+    if( bind( fd, (struct sockaddr *)&addr, sizeof(addr) ) < 0 || listen( fd, 8 ) < 0 )
+    {
+        close( fd );
+        return -1;
+    }
+    // a client that gave up between poll() and accept() mustn't block the exporter
+    fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );
+
+
+    return fd;
+}
+
+
+int oob_metrics_start( oob_metrics *m, const char *target, int interval )
+{
+    int len;
+
+
+    memset( m, 0, sizeof(*m) );
+    m->listen_fd = -1;
+    m->interval = interval > 0 ? interval : OOB_METRICS_INTERVAL;
+    strncpy( m->target, target, sizeof(m->target)-1 );
+    len = strlen( m->target );
+    m->json = len > 5 && !strcmp( m->target + len - 5, ".json" );
+    m->start_time = m->rate_time = oob_metrics_now();
+    pthread_mutex_init( &m->lock, NULL );
+
+    if( !strncmp( m->target, "unix:", 5 ) )
+    {
+        m->listen_fd = oob_metrics_listen( m->target + 5 );
+        if( m->listen_fd < 0 )
+            goto end_fail;
+    }
+
+    m->stop_fd = eventfd( 0, 0 );
+    if( m->stop_fd < 0 )
+        goto end_fail;
+
+    if( pthread_create( &m->thread, NULL, oob_metrics_thread, m ) )
+    {
+        close( m->stop_fd );
+        goto end_fail;
+    }
+    m->running = 1;
+
+
+    return 0;
+
+
+end_fail:
+    if( m->listen_fd >= 0 )
+    {
+        close( m->listen_fd );
+        unlink( m->target + 5 );
+    }
+    pthread_mutex_destroy( &m->lock );
+
+
+    return -1;
+}
+
+
+int oob_metrics_add( oob_metrics *m, const char *name, const oob_decoder *dec )
+{
+    oob_metrics_source *sources;
+    oob_metrics_source *src;
+
+
+    pthread_mutex_lock( &m->lock );
+    sources = (oob_metrics_source *)realloc( m->sources, (m->nsources + 1) * sizeof(oob_metrics_source) );
+    if( !sources )
+    {
+        pthread_mutex_unlock( &m->lock );
+        return -1;
+    }
+    m->sources = sources;
+
+    src = &m->sources[m->nsources++];
+    memset( src, 0, sizeof(*src) );
+    strncpy( src->name, name, sizeof(src->name)-1 );
+    src->dec = dec;
+    oob_metrics_read( dec, &src->counters );
+    src->rate_in_bytes = src->counters.in_bytes;
+    src->rate_out_bytes = src->counters.out_bytes;
+    pthread_mutex_unlock( &m->lock );
+
+
+    return 0;
+}
+
+
+void oob_metrics_remove( oob_metrics *m, const oob_decoder *dec )
+{
+    int n;
+
+
+    pthread_mutex_lock( &m->lock );
+    for( n=0; n<m->nsources; n++ )
+    {
+        if( m->sources[n].dec == dec )
+        {
+            oob_metrics_read( dec, &m->sources[n].counters );
+            m->sources[n].dec = NULL;
+        }
+    }
+    pthread_mutex_unlock( &m->lock );
+}
+
+
+void oob_metrics_stop( oob_metrics *m )
+{
+    uint64_t one = 1;
+
+
+    if( !m->running )
+        return;
+
+    if( write( m->stop_fd, &one, sizeof(one) ) == sizeof(one) )
+        pthread_join( m->thread, NULL );
+    else
+        pthread_cancel( m->thread );
+    m->running = 0;
+
+    // the final counters, for whatever reads the file after the decoder has exited
+    oob_metrics_snapshot( m, 1 );
+    if( m->listen_fd < 0 )
+        oob_metrics_write_file( m );
+    else
+    {
+        close( m->listen_fd );
+        unlink( m->target + 5 );
+    }
+
+    close( m->stop_fd );
+    free( m->sources );
+    m->sources = NULL;
+    m->nsources = 0;
+    pthread_mutex_destroy( &m->lock );
+}
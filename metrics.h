@@ -0,0 +1,99 @@
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "oobin.h"
+
+
+//----------------
+// Metrics export
+//----------------
+//
+// the statistics of running decoders, exported continuously for monitoring to alert on (sync lost, FEC errors
+// climbing, throughput dropping, ...) - either
+//   <file>            rewritten every interval, as <file>.tmp renamed over it so a reader never sees half of one
+//                     (e.g. a .prom file in the directory of node_exporter's textfile collector)
+//   unix:<path>       served on a UNIX stream socket - each connection is sent the current metrics and closed
+// in Prometheus text format, or JSON if the file / socket name ends in ".json"
+// the exporter has a thread of its own that reads the decoders' 64-bit counters while they are being updated - the
+// decoders take no locks and do nothing for it, each counter is read atomically but a snapshot is not taken at one
+// instant (so it can be a frame or so out between counters)
+// throughput is the change in bytes in / out between two snapshots on the interval, over the time between them
+
+
+#define OOB_METRICS_INTERVAL    5           // seconds between snapshots, by default
+
+
+// the counters of one decoder, as read by the exporter
+typedef struct oob_metrics_counters
+{
+    uint64_t in_bytes;
+    uint64_t out_packets;
+    uint64_t frames;
+    uint64_t sync_locks;
+    uint64_t sync_losses;
+    uint64_t flywheel_frames;
+    uint64_t fec_blocks;
+    uint64_t fec_error_blocks;
+    uint64_t fec_corrected_blocks;
+    uint64_t fec_erasure_blocks;
+    uint64_t fec_ambiguous_blocks;
+    uint64_t tei_packets;
+    uint64_t pid_dropped_packets;
+    uint64_t out_bytes;                 // worked out from the counters above
+    uint64_t fec_uncorrectable_blocks;
+    uint64_t sync_locked;               // 1 while the sync tracker is locked
+    uint64_t in_bytes_per_second;       // over the last interval
+    uint64_t out_bytes_per_second;
+} oob_metrics_counters;
+
+
+typedef struct oob_metrics_source
+{
+    char name[256];                     // exported as the label stream="<name>" - "" for no label
+    const oob_decoder *dec;             // NULL once removed - the counters stay at their final values
+    oob_metrics_counters counters;      // last snapshot
+    uint64_t rate_in_bytes;             // in_bytes / out_bytes at the last interval, for the throughput
+    uint64_t rate_out_bytes;
+} oob_metrics_source;
+
+
+typedef struct oob_metrics
+{
+    char target[FILENAME_MAX];
+    int json;
+    int interval;
+    int listen_fd;                      // unix: target, else -1
+    int stop_fd;                        // eventfd - written by oob_metrics_stop()
+
+    // sources[] is locked by the exporter thread and by adding / removing a source - never by a decoder
+    pthread_mutex_t lock;
+    oob_metrics_source *sources;
+    int nsources;
+
+    pthread_t thread;
+    int running;
+    double start_time;
+    double rate_time;                   // when the rates were last worked out
+} oob_metrics;
+
+
+// start exporting to target ("<file>" or "unix:<path>") every interval seconds - sources are added after
+// return value: 0 if successful, negative value if the socket could not be set up or the thread started
+int oob_metrics_start( oob_metrics *m, const char *target, int interval );
+
+// export the counters of dec (set up by oob_decoder_init()) from now on, labelled with name ("" for none)
+// return value: 0 if successful, negative value if out of memory
+int oob_metrics_add( oob_metrics *m, const char *name, const oob_decoder *dec );
+
+// stop reading dec (before it is freed) - its final counters go on being exported
+void oob_metrics_remove( oob_metrics *m, const oob_decoder *dec );
+
+// write one last snapshot (to a file target), stop the exporter thread and remove a socket
+void oob_metrics_stop( oob_metrics *m );
+
+
+#endif  // _METRICS_H
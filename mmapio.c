@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mmapio.h"
+#include "arena.h"
+
+
+// decode the regular file fd into OutFile, chunk_bytes of the mapping at a time
+// return value: 0 if successful, -1 if fd can't be mapped (not a regular file, too large for the address space, ...)
+//               - nothing has been read then and the caller can fall back to reading it, -2 on write error
+int oob_mmap_run( int fd, FILE *OutFile, int chunk_bytes, oob_decoder *dec )
+{
+    struct stat st;
+    uint8_t *map;
+    oob_arena out;                      // TS packets decoded from one window
+    int *frame_ofs;
+    uint64_t size;
+    uint64_t pos = 0;                   // start of the next window - where the sync tracker stopped
+    uint64_t advised = 0;               // end of the range requested with MADV_WILLNEED so far
+    uint64_t dropped = 0;               // start of the pages still mapped in
+    uint64_t page = sysconf( _SC_PAGESIZE );
+    uint64_t n;
+    int len;
+    int consumed;
+    int nframes;
+    int npackets;
+    int ret = 0;
+
+
+    if( fstat( fd, &st ) < 0 || !S_ISREG( st.st_mode ) )
+        return -1;
+
+    size = (uint64_t)st.st_size;
+    if( size == 0 )
+        return 0;
+    if( (uint64_t)(size_t)size != size )
+        return -1;          // doesn't fit in the address space
+
+    map = (uint8_t *)mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+    if( map == MAP_FAILED )
+        return -1;
+
+    madvise( map, size, MADV_SEQUENTIAL );
+
+
+    // a window of at least 2 frames' worth always lets the sync tracker move on
+    if( chunk_bytes < 2*1152 )
+        chunk_bytes = 2*1152;
+
+    frame_ofs = (int *)malloc( (chunk_bytes/384 + 1) * sizeof(int) );
+    if( oob_arena_alloc( &out, (chunk_bytes/384 + 1) * 376 ) < 0 || !frame_ofs )
+    {
+        fprintf( stderr, "Error - unable to malloc(%d) mmap output buffers - aborting.\n", (chunk_bytes/384 + 1) * 376 );
+        ret = -2;
+        goto end_free;
+    }
+
+
+    while( pos < size )
+    {
+        len = size - pos < (uint64_t)chunk_bytes ? (int)(size - pos) : chunk_bytes;
+
+        if( advised < size && advised < pos + OOB_MMAP_READAHEAD/2 )
+        {   // keep the next OOB_MMAP_READAHEAD bytes on their way in
+            n = size - advised < OOB_MMAP_READAHEAD ? size - advised : OOB_MMAP_READAHEAD;
+            madvise( map + advised, n, MADV_WILLNEED );
+            advised += n;
+        }
+
+        consumed = oob_scan_data_chunk( dec, map + pos, len, frame_ofs, &nframes );
+        if( nframes > 0 )
+        {
+            npackets = oob_decode_frames( dec, map + pos, NULL, frame_ofs, nframes, out.base );
+            OOB_PROF_START( t );
+            n = fwrite( out.base, 1, npackets * 188, OutFile );
+            OOB_PROF_LAP( &dec->prof, OOB_PROF_WRITE, t, n );
+            if( n < npackets * 188 )
+            {
+                fprintf( stderr, "Error writing output file - aborting.\n" );
+                ret = -2;
+                break;
+            }
+        }
+
+        dec->in_byte_count += consumed ? consumed : len;
+        if( consumed == 0 )
+            break;          // not enough left for another frame
+        pos += consumed;
+
+        if( pos - dropped >= OOB_MMAP_DROP )
+        {   // the decoder never goes back - let go of the pages behind it (and of the page cache copy)
+            n = (pos & ~(page-1)) - dropped;
+            madvise( map + dropped, n, MADV_DONTNEED );
+            posix_fadvise( fd, dropped, n, POSIX_FADV_DONTNEED );
+            dropped += n;
+        }
+    }
+
+
+end_free:
+    oob_arena_free( &out );
+    free( frame_ofs );
+    munmap( map, size );
+
+
+    return ret;
+}
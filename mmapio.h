@@ -0,0 +1,30 @@
+#ifndef _MMAPIO_H
+#define _MMAPIO_H
+
+#include <stdio.h>
+
+#include "oobin.h"
+
+
+//---------------------------
+// Memory-mapped file input
+//---------------------------
+//
+// a regular input file is mapped whole and decoded straight from the mapping - no read() copy into a buffer and no
+// remainder memmove, the window after the last frame decoded simply starts where the sync tracker stopped
+// the kernel is told the mapping is read sequentially, the next OOB_MMAP_READAHEAD bytes are requested ahead of the
+// decoder and the pages behind it are dropped, so a multi-gigabyte capture doesn't push everything else out of memory
+// file positions are 64-bit, only the window handed to oob_scan_data_chunk() at a time is limited to an int
+
+
+#define OOB_MMAP_READAHEAD      (8 << 20)   // bytes ahead of the decoder requested with MADV_WILLNEED
+#define OOB_MMAP_DROP           (8 << 20)   // pages behind the decoder are dropped once this many bytes have been decoded
+
+
+// decode the regular file fd into OutFile, chunk_bytes of the mapping at a time
+// return value: 0 if successful, -1 if fd can't be mapped (not a regular file, too large for the address space, ...)
+//               - nothing has been read then and the caller can fall back to reading it, -2 on write error
+int oob_mmap_run( int fd, FILE *OutFile, int chunk_bytes, oob_decoder *dec );
+
+
+#endif  // _MMAPIO_H
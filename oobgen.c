@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#include "encoder.h"
+
+
+#define FRAMES_PER_CHUNK    256             // frames read, encoded and written at a time
+
+
+int main( int argc, char **argv )
+{
+    int opt;                            // for command-line parsing
+    char in_filename[FILENAME_MAX] = "-";
+    char out_filename[FILENAME_MAX] = "-";
+    char flags_filename[FILENAME_MAX] = "";
+    FILE *InFile;
+    FILE *OutFile;
+    FILE *FlagsFile = NULL;
+    uint8_t *InData;
+    uint8_t *OutData;
+    uint8_t *FlagsData;                 // erasure flags for each byte of OutData[]
+    int OutDataLen;
+    int BytesRead;
+    uint64_t seed = 1;
+    int garbage = 0;                    // # of random bytes before the first frame
+    int repeat = 1;                     // # of times the input file is encoded
+    int bad_sync = 0;
+    uint64_t frames = 0;
+    uint64_t total_bytes = 0;
+    oob_encoder enc;
+    oob_impairments imp;
+    int n, k;
+
+
+    memset( &imp, 0, sizeof(imp) );
+    imp.burst_len = 8;
+
+// parse command-line arguments (argv)
+    while( (opt = getopt(argc, argv, "hf:w:m:s:e:u:l:p:y:g:r:")) != -1 )
+    {
+        switch (opt)
+        {
+          case 'h':
+          default:
+            printf( "%s %s - SCTE 55-1 OOB bitstream generator\n\n", "oobgen", _SOFT_VER_ );
+            printf( "f <filename> input TS filename - use \"-\" for stdin - default: \"%s\"\n", in_filename );
+            printf( "w <outfile>  output OOB bitstream filename (will be overwritten) - default: \"%s\"\n", out_filename );
+            printf( "m <flagfile> also write the erasure flags for oobin -E - 1 for each bitstream byte that was hit, 0 for the rest\n" );
+            printf( "s <n>        random seed for the impairments (default: %llu)\n", (unsigned long long)seed );
+            printf( "e <rate>     random symbol errors - probability of each byte being hit (default: 0)\n" );
+            printf( "u <rate>     error bursts - probability of a burst starting at each byte (default: 0)\n" );
+            printf( "l <n>        error bursts - # of bytes hit by each burst (default: %d)\n", imp.burst_len );
+            printf( "p <rate>     byte slips - probability of a byte being dropped or inserted in each frame (default: 0)\n" );
+            printf( "y <rate>     sync corruption - probability of a frame's sync byte being hit (default: 0)\n" );
+            printf( "g <n>        # of random bytes before the first frame (default: %d)\n", garbage );
+            printf( "r <n>        encode the input file n times over (default: %d)\n", repeat );
+            printf( "\n" );
+            return 1;
+
+          case 'f':
+            strncpy( in_filename, optarg, sizeof(in_filename)-1 );
+            break;
+
+          case 'w':
+            strncpy( out_filename, optarg, sizeof(out_filename)-1 );
+            break;
+
+          case 'm':
+            strncpy( flags_filename, optarg, sizeof(flags_filename)-1 );
+            break;
+
+          case 's':
+            seed = strtoull( optarg, NULL, 0 );
+            break;
+
+          case 'e':
+            imp.symbol_error_rate = strtod( optarg, NULL );
+            break;
+
+          case 'u':
+            imp.burst_rate = strtod( optarg, NULL );
+            break;
+
+          case 'l':
+            imp.burst_len = strtoul( optarg, NULL, 0 );
+            break;
+
+          case 'p':
+            imp.slip_rate = strtod( optarg, NULL );
+            break;
+
+          case 'y':
+            imp.sync_error_rate = strtod( optarg, NULL );
+            break;
+
+          case 'g':
+            garbage = strtoul( optarg, NULL, 0 );
+            break;
+
+          case 'r':
+            repeat = strtoul( optarg, NULL, 0 );
+            break;
+        }
+    }
+
+
+    if( !strcmp( in_filename, "-" ) )
+        InFile = stdin;
+    else
+        InFile = fopen( in_filename, "rb" );
+    if( !InFile )
+    {
+        fprintf( stderr, "Error - unable to open input file '%s' - aborting.\n", in_filename );
+        return 2;
+    }
+
+    if( !strcmp( out_filename, "-" ) )
+        OutFile = stdout;
+    else
+        OutFile = fopen( out_filename, "wb" );
+    if( !OutFile )
+    {
+        fprintf( stderr, "Error - unable to open output file '%s' - aborting.\n", out_filename );
+        fclose( InFile );
+        return 2;
+    }
+
+    if( strlen(flags_filename) )
+    {
+        FlagsFile = fopen( flags_filename, "wb" );
+        if( !FlagsFile )
+        {
+            fprintf( stderr, "Error - unable to open erasure flags file '%s' - aborting.\n", flags_filename );
+            fclose( OutFile );
+            fclose( InFile );
+            return 2;
+        }
+    }
+
+    // each frame is 2 TS packets in, 384 bitstream bytes out (385 with an inserted byte), plus the flushed delay line
+    InData = (uint8_t *)malloc( FRAMES_PER_CHUNK * 376 );
+    OutData = (uint8_t *)malloc( FRAMES_PER_CHUNK * 385 + 768 + garbage );
+    FlagsData = (uint8_t *)calloc( 1, FRAMES_PER_CHUNK * 385 + 768 + garbage );
+    if( !InData || !OutData || !FlagsData )
+    {
+        fprintf( stderr, "Error - unable to malloc() buffers - aborting.\n" );
+        goto end_free;
+    }
+
+
+    oob_encoder_init( &enc );
+    oob_impairments_init( &imp, seed );
+
+    OutDataLen = garbage;
+    oob_impair_garbage( &imp, OutData, garbage );
+
+
+    while( repeat > 0 )
+    {
+        BytesRead = fread( InData, 1, FRAMES_PER_CHUNK * 376, InFile );
+        if( BytesRead < 1 )
+        {
+            if( --repeat == 0 || fseek( InFile, 0, SEEK_SET ) )
+                break;
+            continue;
+        }
+
+        if( BytesRead % 376 )
+        {   // an odd packet (or partial packet) at the end - pad the frame out with a null packet
+            n = BytesRead - BytesRead % 376;
+            memset( InData + BytesRead, 0xFF, n + 376 - BytesRead );
+            if( BytesRead - n < 188 )
+                BytesRead = n;      // partial packet - dropped
+            else
+            {   // the null packet replaces anything read of a partial packet behind the odd one
+                memset( InData + n + 188, 0xFF, 188 );
+                InData[n + 188] = 0x47;
+                InData[n + 189] = 0x1F;
+                InData[n + 191] = 0x10;
+                BytesRead = n + 376;
+            }
+        }
+
+        for( k=0; k<BytesRead; k+=376 )
+        {
+            if( !bad_sync && (InData[k] != 0x47 || InData[k+188] != 0x47) )
+            {
+                fprintf( stderr, "Warning - input is not aligned 188-byte TS packets (no 0x47 sync byte at %llu) - the bitstream won't synchronize.\n", (unsigned long long)(frames * 376) );
+                bad_sync = 1;
+            }
+
+            oob_encode_frame( &enc, InData + k, OutData + OutDataLen );
+            OutDataLen += oob_impair_frame( &imp, OutData + OutDataLen, FlagsData + OutDataLen );
+            frames++;
+        }
+
+        if( fwrite( OutData, 1, OutDataLen, OutFile ) < OutDataLen )
+        {
+            fprintf( stderr, "Error writing output file - aborting.\n" );
+            goto end_free;
+        }
+        if( FlagsFile && fwrite( FlagsData, 1, OutDataLen, FlagsFile ) < OutDataLen )
+        {
+            fprintf( stderr, "Error writing erasure flags file - aborting.\n" );
+            goto end_free;
+        }
+        memset( FlagsData, 0, OutDataLen );
+        total_bytes += OutDataLen;
+        OutDataLen = 0;
+    }
+
+    // the rest of the interleaver delay line - the last frame needs it to be decoded
+    oob_encoder_flush( &enc, OutData + OutDataLen );
+    OutDataLen += 768;
+    if( fwrite( OutData, 1, OutDataLen, OutFile ) < OutDataLen )
+        fprintf( stderr, "Error writing output file - aborting.\n" );
+    if( FlagsFile && fwrite( FlagsData, 1, OutDataLen, FlagsFile ) < OutDataLen )
+        fprintf( stderr, "Error writing erasure flags file - aborting.\n" );
+    total_bytes += OutDataLen;
+
+    fprintf( stderr, "Frames: %llu (%llu TS packets), bitstream bytes: %llu\n", (unsigned long long)frames, (unsigned long long)frames * 2, (unsigned long long)total_bytes );
+    fprintf( stderr, "Injected symbol errors: %llu, bursts: %llu, byte slips: %llu, sync errors: %llu\n",
+             (unsigned long long)imp.symbol_errors, (unsigned long long)imp.bursts, (unsigned long long)imp.slips, (unsigned long long)imp.sync_errors );
+
+
+end_free:
+    free( InData );
+    free( OutData );
+    free( FlagsData );
+    if( FlagsFile )
+        fclose( FlagsFile );
+    fclose( OutFile );
+    fclose( InFile );
+
+
+    return 0;
+}
@@ -1,5 +1,7 @@
+#include <pthread.h>
+
 #include "oobin.h"
-#include "rscode-1.3/ecc.h"
+#include "kernels.h"
 
 
 //-----------------------------------------------------
@@ -17,6 +19,67 @@
 // 4. Drop 2 parity bytes from end of each 96 byte block (convert 192 bytes to 188 byte TS packets)
 
 
+//-----------------
+// Decoder context
+//-----------------
+
+// the GF tables are shared by all decoders - they are built once, by whichever decoder needs them first
+static pthread_once_t oob_ecc_once = PTHREAD_ONCE_INIT;
+
+// the vectorized kernels are picked (and checked) once as well
+static pthread_once_t oob_kernels_once = PTHREAD_ONCE_INIT;
+
+
+// build the shared GF tables and generator polynomial (once) - used by decoders with FEC and by the encoder
+void oob_ecc_init( void )
+{
+    pthread_once( &oob_ecc_once, initialize_ecc );
+}
+
+
+// initialize a decoder context - must be called before the context is passed to any other oob_ function
+// if do_fec is 0 then FEC bytes will be ignored.  if do_fec==1 then FEC will be checked and repair attempted
+void oob_decoder_init( oob_decoder *dec, int do_fec )
+{
+    memset( dec, 0, sizeof(*dec) );
+
+    dec->do_fec = do_fec;
+
+    dec->sync.state = OOB_SYNC_ACQUIRE;
+    dec->sync.lock_syncs = OOB_SYNC_LOCK_SYNCS;
+    dec->sync.unlock_misses = OOB_SYNC_UNLOCK_MISSES;
+
+    pthread_once( &oob_kernels_once, oob_kernels_init );
+
+    if( do_fec )
+        oob_ecc_init();
+}
+
+
+void oob_decoder_merge_stats( oob_decoder *dst, oob_decoder *src )
+{
+    __atomic_fetch_add( &dst->fec_error_count, src->fec_error_count, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &dst->fec_total_block_count, src->fec_total_block_count, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &dst->fec_corrected_block_count, src->fec_corrected_block_count, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &dst->fec_erasure_block_count, src->fec_erasure_block_count, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &dst->fec_ambiguous_block_count, src->fec_ambiguous_block_count, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &dst->pid_dropped_count, src->pid_dropped_count, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &dst->frame_count, src->frame_count, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &dst->out_packet_count, src->out_packet_count, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &dst->tei_packet_count, src->tei_packet_count, __ATOMIC_RELAXED );
+
+    src->fec_error_count = 0;
+    src->fec_total_block_count = 0;
+    src->fec_corrected_block_count = 0;
+    src->fec_erasure_block_count = 0;
+    src->fec_ambiguous_block_count = 0;
+    src->pid_dropped_count = 0;
+    src->frame_count = 0;
+    src->out_packet_count = 0;
+    src->tei_packet_count = 0;
+}
+
+
 //-------------------
 // 1. De-interleaver
 //-------------------
@@ -43,6 +106,25 @@ int oob_de_interleaver( uint8_t *data_in, uint8_t *data_out )
 }
 
 
+// scalar reference for oob_de_interleave_frame() - oob_de_interleaver() for each of the 4 blocks
+void oob_de_interleave_frame_scalar( uint8_t *data_in, uint8_t *frame_out )
+{
+    int n;
+
+
+    for( n=0; n<4; n++ )
+        oob_de_interleaver( data_in + n*96, frame_out + n*96 );
+}
+
+
+// de-interleave all four 96-byte blocks of a frame in one call (vectorized when the CPU supports it)
+// data_in[] must contain at least 1152 bytes, frame_out[] gets the 384-byte de-interleaved frame
+void oob_de_interleave_frame( uint8_t *data_in, uint8_t *frame_out )
+{
+    oob_de_interleave_frame_kernel( data_in, frame_out );
+}
+
+
 //-------------------------
 // 2. Reed Solomon Decoder
 //-------------------------
@@ -72,52 +154,197 @@ int oob_de_interleaver( uint8_t *data_in, uint8_t *data_out )
 
 
 
+// closed-form single error correction for the T=1 RS(96,94) code
+// decode_data() leaves the syndromes in rs->synBytes[], computed by Horner's rule so that with a single error of
+// magnitude e at location L (counted from the last byte of the block, L=0 is data_in[95]):
+//   S1 = e * α^L
+//   S2 = e * α^2L
+// so the error location is α^L = S2/S1 and the error magnitude is e = S1/α^L
+// this replaces Modified_Berlekamp_Massey() + Find_Roots() (Chien search over all 255 field elements)
+// return value: 1 if the error was corrected, -1 if the block is uncorrectable (data_in[] is left untouched)
+static int oob_rs_correct_single( RS_STATE *rs, uint8_t *data_in )
+{
+    int s1 = rs->synBytes[0];
+    int s2 = rs->synBytes[1];
+    int loc;
+
+
+    if( s1 == 0 || s2 == 0 )
+        return -1;          // more than one symbol in error - a single error always gives two non-zero syndromes
+
+    loc = glog[s2] - glog[s1];
+    if( loc < 0 )
+        loc += 255;
 
-// variables to keep track of FEC errors for statistics
-int fec_error_count = 0;
-int fec_total_block_count = 0;          // # of 96-byte FEC blocks processed (1 TS packet = 2 FEC blocks)
-int fec_corrected_block_count = 0;
+    if( loc >= 96 )
+        return -1;          // error location falls in the 159 virtual leading zero symbols of the (255,253) code - uncorrectable
+
+    data_in[95 - loc] ^= gexp[glog[s1] - loc + 255];
+
+
+    return 1;
+}
+
+
+// closed-form solution for 2 erasures - errors at the known locations L1 and L2 (counted like oob_rs_correct_single())
+// with X1 = α^L1, X2 = α^L2 and the unknown magnitudes e1, e2:
+//   S1 = e1*X1   + e2*X2
+//   S2 = e1*X1^2 + e2*X2^2
+// so S2 + X1*S1 = e2*X2*(X1 + X2), which gives e2, and then e1 = (S1 + e2*X2) / X1
+// both parity symbols are used up by the 2 unknowns, there is nothing left over to check the result against -
+// the flags have to be right (a flagged symbol that was received correctly just gets a magnitude of 0), oob_rs_correct()
+// only trusts them if the syndromes don't point at a single error somewhere else
+static void oob_rs_correct_erasures( RS_STATE *rs, uint8_t *data_in, int l1, int l2 )
+{
+    int s1 = rs->synBytes[0];
+    int s2 = rs->synBytes[1];
+    int num;
+    int e1, e2;
+
+
+    num = s2 ^ (s1 ? gexp[glog[s1] + l1] : 0);
+    e2 = num ? gexp[(glog[num] + 510 - l2 - glog[gexp[l1] ^ gexp[l2]]) % 255] : 0;
+
+    num = s1 ^ (e2 ? gexp[glog[e2] + l2] : 0);
+    e1 = num ? gexp[glog[num] + 255 - l1] : 0;
+
+    data_in[95 - l1] ^= e1;
+    data_in[95 - l2] ^= e2;
+}
+
+
+// correct a block whose syndromes in dec->rs are not all zero - the error path of oob_de_fec_erasures() and oob_de_fec_batch()
+// return value: 1 if one error was corrected, 2 if two erasures were filled in, -1 if the block is unrecoverable
+static int oob_rs_correct( oob_decoder *dec, uint8_t *data_in, const uint8_t *erasures )
+{
+    uint8_t single[96];
+    int loc[2];
+    int nerasures = 0;
+    int n;
+
+
+    dec->fec_error_count++;
+
+    if( erasures )
+    {
+        for( n=0; n<96 && nerasures<=2; n++ )
+        {
+            if( erasures[n] )
+            {
+                if( nerasures < 2 )
+                    loc[nerasures] = 95 - n;
+                nerasures++;
+            }
+        }
+    }
+
+    if( nerasures == 2 )
+    {   // exactly 2 flagged symbols - solve for both (with 1 flag the single error search finds it anyway)
+        // unless the syndromes also fit one error at an unflagged symbol - then either the flags are wrong or there is
+        // one unflagged error, and there is no telling which: the block is left as it is and counted as corrupt
+        memcpy( single, data_in, 96 );
+        if( oob_rs_correct_single( &dec->rs, single ) > 0 )
+        {
+            for( n=0; n<96; n++ )
+                if( single[n] != data_in[n] && n != 95 - loc[0] && n != 95 - loc[1] )
+                    break;
+            if( n < 96 )
+            {
+                dec->fec_ambiguous_block_count++;
+                return -1;
+            }
+        }
+
+        oob_rs_correct_erasures( &dec->rs, data_in, loc[0], loc[1] );
+        dec->fec_corrected_block_count++;
+        dec->fec_erasure_block_count++;
+        return 2;
+    }
+
+    // a corrected single error always leaves an all-zero syndrome, no need to decode again to check it
+    if( oob_rs_correct_single( &dec->rs, data_in ) > 0 )
+    {   // this block is valid
+        dec->fec_corrected_block_count++;
+        return 1;       // return 1 indicating a repair was successful, block is valid
+    }
+
+
+    return -1;          // return -1 indicating the block is corrupt
+}
 
 
 // works over 96-byte blocks (runs twice for each ts packet)
 // return value: 0 or positive value if successful - this 96-byte block is valid - positive value indicates errors corrected
 // return negative value in case of invalid/unrecoverable block
-int oob_de_fec( uint8_t *data_in )
+int oob_de_fec( oob_decoder *dec, uint8_t *data_in )
 {
-    fec_total_block_count++;
+    return oob_de_fec_erasures( dec, data_in, NULL );
+}
+
+
+// oob_de_fec() with erasure flags aligned with the de-interleaved block - only looked at if the block has errors
+// return value: 0 if the block is valid, 1 if one error was corrected, 2 if two erasures were filled in, negative value if unrecoverable
+int oob_de_fec_erasures( oob_decoder *dec, uint8_t *data_in, const uint8_t *erasures )
+{
+    dec->fec_total_block_count++;
 
     // Now decode -- encoded codeword size must be passed
-    decode_data( data_in, 96 );
+    decode_data( &dec->rs, data_in, 96 );
 
     // check if syndrome is all zeros
-    if( check_syndrome () != 0 )
-    {           // error(s) found
-        int erasures[16];
-        int nerasures = 0;
+    if( check_syndrome( &dec->rs ) != 0 )
+        return oob_rs_correct( dec, data_in, erasures );
+
 
-        fec_error_count++;
+    return 0;               // return 0 indicating the block is valid
+}
 
-  // We need to indicate the position of the erasures.  Eraseure
-  // positions are indexed (1 based) from the end of the message...
-//  erasures[nerasures++] = ML-17;
-//  erasures[nerasures++] = ML-19;
 
-        correct_errors_erasures( data_in, 96, nerasures, erasures );
+// FEC check and repair of nblocks 96-byte blocks, stride bytes apart from blocks[] (e.g. the de-interleaved frames of a chunk)
+// the syndromes of all blocks are computed first, together, one block per vector lane (decode_data_batch()) - only the
+// blocks with a non-zero syndrome go on to correction, the clean ones (the common case) are done with after that pass
+// erasures[] is NULL, or the flags of each block stride bytes apart like the blocks (see oob_de_fec_erasures())
+// status[k] gets what oob_de_fec_erasures() would have returned for block k
+// return value: # of blocks that are still corrupt (status < 0)
+int oob_de_fec_batch( oob_decoder *dec, uint8_t *blocks, const uint8_t *erasures, int stride, int nblocks, int8_t *status )
+{
+    uint8_t syn[NPAR * OOB_FEC_BATCH_BLOCKS];
+    int nbad = 0;
+    int batch;
+    int nz;
+    int j, k;
 
-        // decode again - check to see if the error was corrected
-        decode_data( data_in, 96 );
 
-        if( check_syndrome () == 0 ) 
-        {   // this block is valid
-            fec_corrected_block_count++;
-            return 1;       // return 1 indicating a repair was successful, block is valid
+    // in slices of OOB_FEC_BATCH_BLOCKS, so syn[] fits on the stack
+    for( ; nblocks > 0; nblocks -= batch, blocks += batch*stride, status += batch )
+    {
+        batch = nblocks < OOB_FEC_BATCH_BLOCKS ? nblocks : OOB_FEC_BATCH_BLOCKS;
+
+        decode_data_batch( blocks, 96, stride, batch, syn );
+        dec->fec_total_block_count += batch;
+
+        for( k=0; k<batch; k++ )
+        {
+            nz = 0;
+            for( j=0; j<NPAR; j++ )
+                nz |= syn[j*batch + k];
+            status[k] = 0;
+            if( !nz )
+                continue;
+
+            for( j=0; j<NPAR; j++ )
+                dec->rs.synBytes[j] = syn[j*batch + k];
+            status[k] = oob_rs_correct( dec, blocks + k*stride, erasures ? erasures + k*stride : NULL );
+            if( status[k] < 0 )
+                nbad++;
         }
-        
-        return -1;          // return -1 indicating the block is corrupt
+
+        if( erasures )
+            erasures += batch*stride;
     }
 
 
-    return 0;               // return 0 indicating the block is valid
+    return nbad;
 }
 
 
@@ -127,32 +354,31 @@ int oob_de_fec( uint8_t *data_in )
 //-----------------
 
 // works over 384-byte blocks (2x ts packets)
-// len is number of bytes to de_randomize - usually this is 384, but less is accepted
+// len is number of bytes to de_randomize - usually this is 384, but any length is accepted (ie: a single 188-byte ts packet)
 // frame_pos is the position within 384-byte randomizer frame  (ie: 192 if de_randomizing 2nd ts packet alone)
+// the gated parity byte positions are zero in oob_rand_mask[], so this is a plain XOR with no per-byte test,
+// done a whole vector at a time by oob_xor_kernel - it only has to split where the 384-byte randomizer frame wraps around
 // return value: 0 if successful
 int oob_de_randomizer( uint8_t *data, int len, int frame_pos )
 {
-    int i;
+    int n;
+
 
+    frame_pos %= 384;
+    if( frame_pos < 0 )
+        frame_pos += 384;
 
-    for( i=0; i<len; i++ )
+    while( len > 0 )
     {
-        switch( i%384 )
-        {
-            case 94:    // The randomizing action is gated out during bytes 95-96, 191-192, 287-288 and 383-384.                           
-            case 95:    // The reason for these gaps in the randomization process is to permit the insertion of Reed Solomon parity bytes. 
-            case 190:   // The PN generator continues to run during these gaps but the output is not used.                                 
-            case 191:   // The RS bytes are inserted without being randomized.                                                             
-            case 286:
-            case 287:
-            case 382:
-            case 383:
-                break;
-            
-            default:
-                data[i] ^= oob_rand_table[i%384];
-                break;
-        }
+        n = 384 - frame_pos;
+        if( n > len )
+            n = len;
+
+        oob_xor_kernel( data, data, oob_rand_mask + frame_pos, n );
+
+        data += n;
+        len -= n;
+        frame_pos = 0;
     }
 
 
@@ -160,93 +386,94 @@ int oob_de_randomizer( uint8_t *data, int len, int frame_pos )
 }
 
 
-// 384-byte table of XOR values used for TS randomization
-// oob_rand_table[] can be calculated by oob_calc_rand_table()  (or it can be precalculated and included at compile time)
-const uint8_t oob_rand_table[384] = 
+// oob_rand_mask[], oob_rand_table[] and oob_calc_rand_table() are in randomizer.c
+
+
+
+//---------------------------------
+// 4. Drop parity bytes / fused kernels
+//---------------------------------
+//
+// running 1. - 4. one after the other touches every byte of a frame several times:
+// de-interleave into a work buffer, derandomize it in place, then copy 4x 94 bytes out
+// the parity bytes are the only bytes the derandomizer skips (gated randomizer positions 94-95, 190-191, 286-287, 382-383),
+// and they are dropped anyway - so the output bytes can be produced in one pass straight from the input:
+//
+//   ts_out[94*k + j] = data_in[96*k + j + 96*(j%8)] ^ oob_rand_table[96*k + j]      block k = 0..3, byte j = 0..93
+
+
+// 1. + 3. + 4. in a single pass - de-interleave, derandomize and drop the parity bytes of a whole frame
+// data_in[] is the interleaved bitstream starting at a frame sync byte - it must contain at least 1152 bytes (like oob_de_interleaver())
+// writes 2x 188-byte TS packets (376 bytes) to ts_out[] - used when FEC is not checked
+void oob_de_frame( uint8_t *data_in, uint8_t *ts_out )
 {
-    0x00,0x71,0xC5,0xBC,0x41,0x6E,0x34,0xC6,0x04,0xB6,0xE5,0x97,0x2D,0x7E,0x7D,0x02, 
-    0xED,0xAF,0xBE,0x65,0xE1,0xF4,0x99,0xF8,0x7A,0x3A,0x25,0xDA,0x98,0x6A,0x3A,0xC6, 
-    0x51,0xE0,0xE8,0xE6,0xAF,0xDD,0xE9,0x85,0x2D,0x81,0x87,0x15,0x7F,0x28,0x5A,0xD8, 
-    0x69,0xB4,0xEB,0xB3,0xEB,0x99,0x40,0x9F,0xF8,0x5E,0xA9,0x94,0xEA,0x74,0xFD,0x68, 
-    0x45,0x27,0x2B,0x46,0xBB,0x4F,0x7C,0x28,0x48,0x91,0xB1,0x2C,0x9D,0xF8,0x42,0xD8, 
-    0xFB,0xFA,0x2F,0x70,0x59,0xC4,0x0A,0x92,0x23,0x70,0x10,0xE3,0x68,0xF3,0xFA,0x5E, 
-    0xB5,0xE5,0x85,0x64,0xA6,0xE5,0x74,0xA6,0x06,0xFF,0xDE,0x84,0x23,0xB7,0x08,0x2A, 
-    0xDA,0xC3,0x04,0x80,0x3F,0xFE,0x85,0xE4,0xA1,0xF9,0x2F,0x62,0x10,0x1C,0x92,0xE4, 
-    0x68,0xD9,0x51,0x58,0x0D,0x24,0xD4,0xAE,0xE5,0x05,0x63,0xBA,0xBE,0xB0,0xB0,0xE5, 
-    0xB3,0xBE,0xCF,0x4D,0xEE,0x7A,0xFD,0x3D,0x13,0x2A,0x5A,0xC4,0x18,0xDB,0xFB,0xE8, 
-    0x66,0xA8,0xC1,0xB2,0x41,0x3B,0x62,0xCB,0x75,0x34,0x46,0x03,0xAA,0xBE,0x53,0x3B, 
-    0x9D,0x31,0x62,0xA6,0xC1,0xE7,0x17,0x36,0x13,0x49,0xD6,0xA0,0xC1,0xC3,0x84,0x87, 
-    0x23,0xA5,0x41,0xF2,0x42,0xB5,0x4F,0x29,0x7E,0x45,0xE0,0x33,0x8F,0x09,0x7F,0x82, 
-    0xF6,0xC2,0x8A,0xB1,0xAC,0x9A,0xE4,0x19,0x1C,0xED,0x19,0x63,0x10,0x12,0xAA,0x53, 
-    0xE0,0xF4,0x97,0xC0,0xCD,0xB2,0x08,0x1C,0x00,0xAA,0xAC,0x1A,0xE3,0x05,0x47,0x29, 
-    0x0F,0x80,0x5C,0x72,0xE1,0x3D,0xB9,0x86,0x40,0x27,0x1D,0x9C,0xD2,0xE7,0xE6,0xF4, 
-    0xB3,0x53,0x7C,0x82,0xE4,0x8B,0x52,0x29,0xDA,0xD1,0x4D,0x58,0xA7,0x88,0xCE,0x4D, 
-    0xE0,0x42,0x4A,0xB5,0x3E,0xEC,0xC2,0x04,0x8E,0x07,0x49,0x0D,0xC9,0x67,0x61,0xEF, 
-    0xF4,0xCC,0xAE,0x77,0x4B,0xA7,0x79,0x0C,0xED,0xFA,0xE8,0x68,0x90,0x76,0x3A,0x6C, 
-    0xFD,0xFA,0x0B,0xE3,0xE8,0xF4,0xE6,0x05,0x71,0xF3,0x66,0x28,0xC6,0xAE,0x1A,0xFF, 
-    0x74,0x28,0x39,0x54,0x0D,0x6D,0xF3,0xCC,0x84,0xDC,0x4D,0x1F,0xB8,0x5D,0x27,0xB9, 
-    0x08,0x7F,0x8C,0xCE,0x75,0x02,0x9C,0x6A,0x02,0x24,0x8F,0xC0,0x5F,0xFC,0xCC,0xDF, 
-    0xB2,0xF7,0xE6,0x17,0x38,0x2B,0xFE,0x5E,0x8D,0x07,0x5B,0x44,0x11,0xFF,0x17,0xA4, 
-    0x5D,0x8D,0x15,0x12,0x9C,0x89,0x89,0x5C,0x0D,0x1C,0x36,0x70,0xC5,0xB2,0x79,0xD9 
-};
-
-
-// to calculate const uint8_t oob_rand_table[] use oob_calc_rand_table()
-// uint8_t *table will be filled in with a 384-byte table of XOR values to use for TS randomization
-void oob_calc_rand_table( uint8_t *table )
+    oob_de_frame_kernel( data_in, ts_out );
+}
+
+
+// scalar reference for oob_de_frame()
+void oob_de_frame_scalar( uint8_t *data_in, uint8_t *ts_out )
 {
-    uint8_t output_byte;
-    int output_bit;
+    int k;
     int i;
     int n;
-    uint16_t shift_reg = 0x0201;        // 13-bit LFSR, seed = 0x0201
+    const uint8_t *in;
+    const uint8_t *rand;
 
 
-// The randomizer PN generator is a 13-bit Linear Feedback Shift Register (LFSR) as shown in Figure 2.
-// 
-// Binary arithmetic XOR gates and taps are placed at the output of stages 13, 11, 10, and 1. 
-// 
-// Binary arithmetic XOR gates and taps are placed at the output of stages 13, 11, 10, and 1. The shift register
-// 
-// The shift register is preset with a seed value. 
-// The stages 10 and 1 are loaded with a seed value of "1" and all other stages, 
-// 2 through 9 and 11 through 13 are loaded with a seed value of “0”. 
-// The seed corresponds to 0x0201. 
-
-    for( n=0; n<384; n++ )
+    for( k=0; k<4; k++ )
     {
-        output_byte = 0;                            
-        for( i=0; i<8; i++ )
-        {   // loop for each bit
-            output_bit = shift_reg & 0x1;               // stage 1 xor tap
-            output_bit ^= (shift_reg & 0x200) >> 9;     // stage 10 xor tap
-            output_bit ^= (shift_reg & 0x400) >> 10;    // stage 11 xor tap
-            output_bit ^= (shift_reg & 0x1000) >> 12;   // stage 13 xor tap
-            
-            shift_reg >>= 1;                            // shift the LFSR
-            
-            shift_reg |= (output_bit << 12);            // shift the output_bit back into the LFSR shift_reg
-            
-            output_byte <<= 1;                          // shift the output_bit into our output_byte
-            output_byte |= output_bit;
+        in = data_in + 96*k;
+        rand = oob_rand_table + 96*k;
+
+        for( n=0; n<94; n+=8 )
+        {
+            for( i=0; i<8 && n+i<94; i++ )
+                ts_out[n+i] = in[n + i + i*96] ^ rand[n+i];
         }
-        
-        table[n] = output_byte;
+
+        ts_out += 94;
     }
+}
+
+
+// 3. + 4. in a single pass - derandomize a de-interleaved 384-byte frame and drop its parity bytes
+// writes 2x 188-byte TS packets (376 bytes) to ts_out[] - used after the FEC blocks of the frame have been checked
+void oob_de_randomize_frame( uint8_t *frame, uint8_t *ts_out )
+{
+    int k;
+
 
-    return;
+    for( k=0; k<4; k++ )
+        oob_xor_kernel( ts_out + 94*k, frame + 96*k, oob_rand_table + 96*k, 94 );
 }
 
 
 
 // find a 0x47 sync byte followed by a 0x64 sync byte 192 bytes later
+// candidate offsets are checked a whole vector at a time by oob_sync_scan_kernel
+// return value: offset from start_ofs of the first sync found - if none is found, the first offset that is too close to the end of data[] to check
 int oob_synchronize_bitstream( uint8_t *data, int start_ofs, int len )
+{
+    int n = len - start_ofs - 383;      // # of candidate offsets with a full 384-byte frame behind them
+
+
+    if( n <= 0 )
+        return 0;
+
+
+    return oob_sync_scan_kernel( data + start_ofs, n );
+}
+
+
+// scalar reference for oob_sync_scan_kernel - first i < n with data[i]==0x47 and data[i+192]==0x64, n if there is none
+int oob_sync_scan_scalar( uint8_t *data, int n )
 {
     int i;
     
-    for( i=0; i+start_ofs+384 <= len; i++ )
+    for( i=0; i<n; i++ )
     {
-        if( data[start_ofs+i] == 0x47 && data[start_ofs+i+192] == 0x64 )
+        if( data[i] == 0x47 && data[i+192] == 0x64 )
         {   // we have found what looks like two TS sync bytes in a row
             break;
         }
@@ -256,101 +483,433 @@ int oob_synchronize_bitstream( uint8_t *data, int start_ofs, int len )
 }
 
 
-// process len bytes in data - processes blocks of 384 bytes at a time (2 TS packets)
-// int *out_len is # of processed data bytes that have been put in ts_out[]
-// if do_fec is 0 then FEC bytes will be ignored.  if do_fec==1 then FEC will be checked and repair attempted (may be time consuming)
-// return value: 0 or positive value if successful, return value is number of bytes remaining *data that have not been processed
-// return value is negative in case of error
-int oob_process_data_chunk( uint8_t *data, int len, uint8_t *ts_out, int *out_len, int do_fec )
+// sync tracker - find the next frame to decode at or after data[i], the frame expected there if locked
+// updates the tracker for the frame returned (so the same frame is never counted twice if the caller stops before decoding it)
+// sync->stream_pos must be the position in the bitstream of data[0] (only used for the events)
+// return value: offset of the frame in data[], -1 if there is no frame with 1152 bytes behind it before the end of data[]
+//               - *resume is then the offset to carry over to the next chunk
+int oob_sync_next_frame( oob_sync_tracker *sync, uint8_t *data, int i, int len, int *resume )
 {
-    int i;
-    int n;
-    uint8_t data_work[384];
-    int fec_error[4];
-    static int oob_ecc_initialized = 0;
+    int good;
 
 
-    *out_len = 0;
+    if( sync->state != OOB_SYNC_ACQUIRE )
+    {
+        good = i+192 < len && data[i] == 0x47 && data[i+192] == 0x64;
+
+        // not enough data to decode the expected frame - try again when the next chunk arrives
+        // (unless it is already clear that VERIFY missed the sync, then search on from here like the ACQUIRE state does)
+        if( i+384+768 > len && (good || sync->state == OOB_SYNC_LOCKED || i+192 >= len) )
+        {
+            *resume = i;
+            return -1;
+        }
+
+        if( sync->state == OOB_SYNC_VERIFY )
+        {
+            if( good )
+                goto found;
+        }
+        else if( good )
+        {
+            sync->misses = 0;
+            return i;
+        }
+        else if( ++sync->misses < sync->unlock_misses )
+        {   // flywheel - decode the frame where it should be, FEC will have a go at the damaged sync bytes
+            sync->flywheel_count++;
+            return i;
+        }
+        else
+        {
+            sync->loss_count++;
+            if( sync->event )
+                sync->event( sync->event_arg, OOB_SYNC_EVENT_LOSS, sync->stream_pos + i );
+        }
 
+        sync->state = OOB_SYNC_ACQUIRE;
+    }
 
-    if( do_fec && !oob_ecc_initialized )
-    {   // Initialization the ECC library
-        initialize_ecc ();        
-        oob_ecc_initialized = 1;
+    // search forward for a sync pair
+    i += oob_synchronize_bitstream( data, i, len );
+    if( i+384+768 > len )
+    {   // didn't synchronize before end of the bitstream
+        *resume = i < len ? i : len;
+        return -1;
     }
 
-    
-//-----------------------------------------------------
-// The process going from QPSK demodulator to TS data:
-//-----------------------------------------------------
+    sync->state = OOB_SYNC_VERIFY;
+    sync->good = 0;
 
-    for( i=0; i+383<len; i+=384 )
+
+found:
+    sync->good++;
+    if( sync->lock_syncs > 0 && sync->good >= sync->lock_syncs )
     {
-// 0. Synchronize bitstream (find 0x47 0x64 0x47 0x64 ... sequence)
+        sync->state = OOB_SYNC_LOCKED;
+        sync->misses = 0;
+        sync->lock_count++;
+        if( sync->event )
+            sync->event( sync->event_arg, OOB_SYNC_EVENT_LOCK, sync->stream_pos + i );
+    }
 
-        i += oob_synchronize_bitstream( data, i, len );
-        if( i+384+768>len )
-            break;      // didn't synchronize before end of the bitstream
 
-// data[0] is a 0x47 sync byte, data[192] is a 0x64 sync byte, there are two packets (384 bytes) to process
+    return i;
+}
 
 
-// 1. De-interleaver       - run it twice (96 bytes x 2) to de-interlave a full ts packet
+// find the frames oob_process_data_chunk() would decode in data[] and where it would stop - without modifying data[]
+// the sync positions only depend on the raw (still interleaved) bitstream and the sync tracker, so this walks the same frames as oob_process_data_chunk()
+// advances the sync tracker of dec past the frames found, exactly like oob_process_data_chunk() does
+// if frame_ofs is not NULL the offset of each frame found is stored in frame_ofs[] (room for len/384 entries) and the count in *nframes
+// return value: number of bytes at the start of data[] that oob_process_data_chunk() consumes, the rest is what it would return as remaining
+int oob_scan_data_chunk( oob_decoder *dec, uint8_t *data, int len, int *frame_ofs, int *nframes )
+{
+    int i = 0;
+    int ofs;
+    int n = 0;
+    OOB_PROF_START( t );
 
-// works over 8 * 96-byte blocks, returns a single 96-byte assembled block
-// data_in[] must contain at least 768 bytes
-// return value: 0 if successful
-        for( n=0; n<4; n++ )        
+
+    while( (ofs = oob_sync_next_frame( &dec->sync, data, i, len, &i )) >= 0 )
+    {
+        if( frame_ofs )
+            frame_ofs[n] = ofs;
+        n++;
+        i = ofs + 384;
+    }
+
+    if( nframes )
+        *nframes = n;
+
+    OOB_PROF_LAP( &dec->prof, OOB_PROF_SYNC, t, i );
+
+    dec->sync.stream_pos += i;
+
+
+    return i;
+}
+
+
+// set the Transport Error Indicator of each of the 2 TS packets of a frame that has a block FEC couldn't repair
+// status[] is the oob_de_fec_erasures() result of the frame's 4 blocks
+static int oob_mark_tei( uint8_t *ts_out, const int8_t *status )
+{
+    int marked = 0;
+    int n;
+
+
+    for( n=0; n<2; n++ )    // loop through 2 TS packets to set TS error indicator if necessary
+    {
+        if( status[n*2] < 0 || status[n*2 + 1] < 0 )
         {
-            oob_de_interleaver( data+i + n*96, data_work + n*96 );
-            memcpy( data+i + n*96, data_work + n*96, 96 );
+            ts_out[n*188 + 1] |= 0x80;      // set Transport Error Indicator (TEI) - Set when a demodulator can't correct errors from FEC data; this would inform a stream processor to ignore the packet 
+            marked++;
         }
+    }
+
+
+    return marked;
+}
+
+
+// decode one synchronized 384-byte frame (2 TS packets) - data[0] is a 0x47 sync byte, data[192] is a 0x64 sync byte
+// data[] must contain at least 1152 bytes (the de-interleaver reads 768 bytes from the start of each of the 4 blocks)
+// data[] is not modified - the frame is de-interleaved into a work buffer, so frames can be decoded in any order (or at the same time)
+// writes 2x 188-byte TS packets (376 bytes) to ts_out[]
+// return value: 0 if successful
+int oob_decode_frame( oob_decoder *dec, uint8_t *data, uint8_t *ts_out )
+{
+    return oob_decode_frame_erasures( dec, data, NULL, ts_out );
+}
+
+
+// oob_decode_frame() with erasure flags aligned with data[] - each block's flags are de-interleaved like its data
+// return value: 0 if successful
+int oob_decode_frame_erasures( oob_decoder *dec, uint8_t *data, uint8_t *flags, uint8_t *ts_out )
+{
+    int n;
+    uint8_t data_work[384];
+    uint8_t flags_work[96];
+    int8_t fec_error[4];
+    OOB_PROF_START( t );
+
+
+    dec->frame_count++;
+
+    if( !dec->do_fec )
+    {   // 1. + 3. + 4. nothing to check - de-interleave, derandomize and drop parity bytes in one pass
+        oob_de_frame( data, ts_out );
+        OOB_PROF_LAP( &dec->prof, OOB_PROF_DE_FRAME, t, 384 );
+        return 0;
+    }
+
+
+// 1. De-interleaver       - all 4 blocks (2 ts packets) of the frame in one call
+    oob_de_interleave_frame( data, data_work );
+    OOB_PROF_LAP( &dec->prof, OOB_PROF_DEINTERLEAVE, t, 384 );
 
 // 2. Reed Solomon Decoder - run it twice (96 bytes x 2) to fec a full ts packet, 4 times for a 384-byte block
 // works over 96-byte blocks (runs twice for each ts packet)
 // return value: 0 if successful - this 96-byte block is valid
-      
-        if( do_fec )
+    for( n=0; n<4; n++ )
+    {
+        if( flags )
         {
-            for( n=0; n<4; n++ )
-                fec_error[n] = oob_de_fec( data+i + n*96 );
+            oob_de_interleaver( flags + n*96, flags_work );
+            fec_error[n] = oob_de_fec_erasures( dec, data_work + n*96, flags_work );
         }
+        else
+            fec_error[n] = oob_de_fec( dec, data_work + n*96 );
+    }
+    OOB_PROF_LAP( &dec->prof, OOB_PROF_FEC, t, 384 );
 
 
-// 3. Derandomizer         - run it over ts packet - need to track even/odd sequence to be able to decrypt next packet
-//                                                 OR
-//                                                 - work on pairs of ts packets
-    
-// works over 384-byte blocks (2x ts packet)
-// len is number of bytes to de_randomize - usually this is 384, but less is accepted
-// frame_pos is the position within 384-byte randomizer frame  (ie: 192 if de_randomizing 2nd ts packet alone)
-// return value: 0 if successful
-        oob_de_randomizer( data+i, 384, 0 );
+// 3. + 4. Derandomizer and drop 2 parity bytes from each 96 byte block, straight into ts_out[]
+    oob_de_randomize_frame( data_work, ts_out );
+    dec->tei_packet_count += oob_mark_tei( ts_out, fec_error );
+    OOB_PROF_LAP( &dec->prof, OOB_PROF_DERANDOMIZE, t, 384 );
 
 
-        if( do_fec )
+    return 0;
+}
+
+
+// decode nframes frames - frame k (at data + frame_ofs[k]) to ts_out + k*376 - with the FEC of OOB_FEC_BATCH_FRAMES frames
+// at a time done by one oob_de_fec_batch() call: the frames are de-interleaved side by side into a work buffer, their
+// blocks checked together, then derandomized with the TEI set from the per-block status
+// flags[] is NULL, or erasure flags aligned with data[] (see oob_decode_frame_erasures())
+// gives the same output and statistics as oob_decode_frame_erasures() on each frame
+void oob_decode_frame_batch( oob_decoder *dec, uint8_t *data, uint8_t *flags, int *frame_ofs, int nframes, uint8_t *ts_out )
+{
+    uint8_t data_work[OOB_FEC_BATCH_FRAMES * 384];
+    uint8_t flags_work[OOB_FEC_BATCH_FRAMES * 384];
+    int8_t status[OOB_FEC_BATCH_FRAMES * 4];
+    int batch;
+    int k, n;
+
+
+    if( !dec->do_fec )
+    {   // nothing to batch
+        for( k=0; k<nframes; k++ )
+            oob_decode_frame( dec, data + frame_ofs[k], ts_out + k*376 );
+        return;
+    }
+
+    for( ; nframes > 0; nframes -= batch, frame_ofs += batch, ts_out += batch*376 )
+    {
+        batch = nframes < OOB_FEC_BATCH_FRAMES ? nframes : OOB_FEC_BATCH_FRAMES;
+        OOB_PROF_START( t );
+
+        for( k=0; k<batch; k++ )
         {
-            for( n=0; n<2; n++ )    // loop through 2 TS packets to set TS error indicator if necessary
+            oob_de_interleave_frame( data + frame_ofs[k], data_work + k*384 );
+            if( flags )
             {
-                if( fec_error[n*2] < 0 || fec_error[n*2 + 1] < 0 )
-                {
-                    data[i + n*192 + 1] |= 0x80;        // set Transport Error Indicator (TEI) - Set when a demodulator can't correct errors from FEC data; this would inform a stream processor to ignore the packet 
-                }
+                for( n=0; n<4; n++ )
+                    oob_de_interleaver( flags + frame_ofs[k] + n*96, flags_work + k*384 + n*96 );
             }
         }
+        OOB_PROF_LAP( &dec->prof, OOB_PROF_DEINTERLEAVE, t, batch*384 );
+
+        oob_de_fec_batch( dec, data_work, flags ? flags_work : NULL, 96, batch*4, status );
+        OOB_PROF_LAP( &dec->prof, OOB_PROF_FEC, t, batch*384 );
+        dec->frame_count += batch;
 
-// convert packet from 192-byte to 188-byte format / write 2x 188-byte packets out
-        for( n=0; n<4; n++ )
+        for( k=0; k<batch; k++ )
         {
-            memmove( ts_out, data+i + 96*n, 94 );
-            ts_out += 94;
-            *out_len += 94;
+            oob_de_randomize_frame( data_work + k*384, ts_out + k*376 );
+            dec->tei_packet_count += oob_mark_tei( ts_out + k*376, status + k*4 );
         }
+        OOB_PROF_LAP( &dec->prof, OOB_PROF_DERANDOMIZE, t, batch*384 );
+    }
+}
+
+
+// decode the nframes frames found by oob_scan_data_chunk() into ts_out[] (room for nframes*376 bytes)
+// without a PID filter frame k (at data + frame_ofs[k]) is written to ts_out + k*376, with one the packets it passes are
+// packed together at the start of ts_out[]
+// flags[] is NULL, or erasure flags aligned with data[] (see oob_decode_frame_erasures())
+// the frames are decoded on the threads of dec->pool if there are any
+// return value: # of 188-byte TS packets placed in ts_out[]
+int oob_decode_frames( oob_decoder *dec, uint8_t *data, uint8_t *flags, int *frame_ofs, int nframes, uint8_t *ts_out )
+{
+    int npackets = 0;
+    int batch;
+    int k;
 
+
+    if( dec->pool )
+    {   // the helpers write each frame to its own slot - pack what the filter passes afterwards
+        oob_parallel_decode_frames( dec, data, flags, frame_ofs, nframes, ts_out );
+        return oob_decoder_filter_packets( dec, ts_out, 2*nframes );
+    }
+
+    // each batch of frames is decoded right behind the packets kept so far - dropped packets are overwritten by the next batch
+    for( k=0; k<nframes; k+=batch )
+    {
+        batch = nframes - k < OOB_FEC_BATCH_FRAMES ? nframes - k : OOB_FEC_BATCH_FRAMES;
+        oob_decode_frame_batch( dec, data, flags, frame_ofs + k, batch, ts_out + npackets*188 );
+        npackets += oob_decoder_filter_packets( dec, ts_out + npackets*188, 2*batch );
     }
+
+
+    return npackets;
+}
+
+
+//------------
+// PID filter
+//------------
+
+// set up a filter that passes nothing
+void oob_pid_filter_init( oob_pid_filter *f )
+{
+    memset( f, 0, sizeof(*f) );
+}
+
+
+// pass packets with this PID, to output # route
+void oob_pid_filter_add( oob_pid_filter *f, int pid, int route )
+{
+    pid &= OOB_PID_COUNT - 1;
+
+    f->pass[pid >> 6] |= (uint64_t)1 << (pid & 63);
+    f->route[pid] = route;
+}
+
+
+// keep the npackets TS packets at ts[] that the filter passes, packed together at the start of ts[] in the same order
+// a packet is only moved if one before it was dropped - dropped packets are never copied
+// return value: # of packets kept
+int oob_pid_filter_packets( const oob_pid_filter *f, uint8_t *ts, int npackets )
+{
+    int kept = 0;
+    int n;
+
+
+    for( n=0; n<npackets; n++ )
+    {
+        if( !oob_pid_passes( f, oob_ts_pid( ts + n*188 ) ) )
+            continue;
+        if( kept != n )
+            memcpy( ts + kept*188, ts + n*188, 188 );
+        kept++;
+    }
+
+
+    return kept;
+}
+
+
+// how many of the npackets TS packets at ts[] in a row go to the same output as the first one - *route is set to that output
+// packets of PIDs the filter doesn't pass go to output 0
+// return value: # of packets (at least 1 if npackets > 0)
+int oob_pid_route_run( const oob_pid_filter *f, const uint8_t *ts, int npackets, int *route )
+{
+    int pid;
+    int n;
+
+
+    *route = 0;
+    for( n=0; n<npackets; n++ )
+    {
+        pid = oob_ts_pid( ts + n*188 );
+        if( n == 0 )
+            *route = oob_pid_passes( f, pid ) ? f->route[pid] : 0;
+        else if( (oob_pid_passes( f, pid ) ? f->route[pid] : 0) != *route )
+            break;
+    }
+
+
+    return n;
+}
+
+
+// apply dec->pid_filter to npackets decoded TS packets at ts[] - keeps count of the packets output and dropped
+// return value: # of packets kept, packed together at the start of ts[]
+int oob_decoder_filter_packets( oob_decoder *dec, uint8_t *ts, int npackets )
+{
+    int kept = npackets;
+
+
+    if( dec->pid_filter )
+    {
+        kept = oob_pid_filter_packets( dec->pid_filter, ts, npackets );
+        dec->pid_dropped_count += npackets - kept;
+    }
+    dec->out_packet_count += kept;
+
+
+    return kept;
+}
+
+
+// process len bytes in data - processes blocks of 384 bytes at a time (2 TS packets)
+// int *out_len is # of processed data bytes that have been put in ts_out[] - only the packets dec->pid_filter passes, if it is set
+// if dec->do_fec is 0 then FEC bytes will be ignored.  if dec->do_fec==1 then FEC will be checked and repair attempted (may be time consuming)
+// if threads were started with oob_decoder_set_threads() the frames are decoded in parallel, with the same output as the serial path
+// return value: 0 or positive value if successful, return value is number of bytes remaining *data that have not been processed
+// return value is negative in case of error
+int oob_process_data_chunk( oob_decoder *dec, uint8_t *data, int len, uint8_t *ts_out, int *out_len )
+{
+    int frame_ofs[OOB_FEC_BATCH_FRAMES];
+    int nframes;
+    int i;
+    int ofs;
+    int n;
+
+
+    *out_len = 0;
+
+
+    if( dec->pool )
+    {   // find all frames first - the sync positions only depend on the raw bitstream and the sync tracker - then decode them in parallel
+        i = oob_parallel_process_data_chunk( dec, data, len, ts_out, out_len );
+        if( i >= 0 )
+            goto end_remaining;
+        // could not set up the parallel decode - fall back to the serial path
+        *out_len = 0;
+    }
+
+    
+//-----------------------------------------------------
+// The process going from QPSK demodulator to TS data:
+//-----------------------------------------------------
+
+    i = 0;
+    nframes = 0;
+    OOB_PROF_START( t );
+    do
+    {
+// 0. Synchronize bitstream (find 0x47 0x64 0x47 0x64 ... sequence) - or take the frame 384 bytes on while locked
+        ofs = oob_sync_next_frame( &dec->sync, data, i, len, &i );
+        if( ofs >= 0 )
+        {
+            OOB_PROF_LAP( &dec->prof, OOB_PROF_SYNC, t, ofs + 384 - i );
+            frame_ofs[nframes++] = ofs;
+            i = ofs + 384;
+        }
+
+// data[ofs] is a 0x47 sync byte, data[ofs+192] is a 0x64 sync byte, there are two packets (384 bytes) to process
+// the frames are gathered OOB_FEC_BATCH_FRAMES at a time, so their FEC blocks are checked together
+
+// 1. - 4. de-interleave, FEC, derandomize, drop parity bytes
+        if( nframes == OOB_FEC_BATCH_FRAMES || (ofs < 0 && nframes > 0) )
+        {
+            n = 188 * oob_decode_frames( dec, data, NULL, frame_ofs, nframes, ts_out );
+            ts_out += n;
+            *out_len += n;
+            nframes = 0;
+        }
+        OOB_PROF_RESET( t );
+    } while( ofs >= 0 );
+    dec->sync.stream_pos += i;
 // completed looping through 384-byte blocks
 
 
+end_remaining:
+    dec->in_byte_count += i;
 // return value: 0 or positive value if successful, return value is number of bytes remaining *data that have not been processed
     if( len - i > 0 )
     {
@@ -361,4 +920,3 @@ int oob_process_data_chunk( uint8_t *data, int len, uint8_t *ts_out, int *out_le
     
     return 0;
 }
-
@@ -4,11 +4,164 @@
 #include <string.h>
 #include <stdint.h>
 
+#include "rscode-1.3/ecc.h"
+#include "profile.h"
 
-// variables to keep track of FEC errors for statistics
-extern int fec_error_count;
-extern int fec_total_block_count;           // # of 96-byte FEC blocks processed (1 TS packet = 2 FEC blocks)
-extern int fec_corrected_block_count;
+
+//--------------
+// Sync tracker
+//--------------
+
+// sync tracker states
+#define OOB_SYNC_ACQUIRE        0           // searching the bitstream for a 0x47 / 0x64 sync pair
+#define OOB_SYNC_VERIFY         1           // found sync - checking the next frames are 384 bytes apart before locking
+#define OOB_SYNC_LOCKED         2           // locked - frames are taken every 384 bytes, missed syncs are flywheeled through
+
+// events passed to the sync event callback
+#define OOB_SYNC_EVENT_LOCK     1           // lock_syncs good syncs in a row - now locked
+#define OOB_SYNC_EVENT_LOSS     2           // unlock_misses missed syncs in a row - searching again
+
+// default hysteresis
+#define OOB_SYNC_LOCK_SYNCS     3
+#define OOB_SYNC_UNLOCK_MISSES  3
+
+
+// keeps track of frame sync across chunks of the bitstream
+// while locked the next frame is expected exactly 384 bytes after the last one - a frame with a corrupted sync byte at the
+// expected offset is decoded anyway (flywheel) instead of searching forward and dropping it, FEC can usually repair it
+typedef struct oob_sync_tracker
+{
+    int state;                              // OOB_SYNC_ACQUIRE / OOB_SYNC_VERIFY / OOB_SYNC_LOCKED
+    int lock_syncs;                         // # of good syncs in a row needed to lock - 0 = never lock (search for every frame)
+    int unlock_misses;                      // # of missed syncs in a row that lose lock
+    int good;                               // good syncs in a row so far (VERIFY)
+    int misses;                             // missed syncs in a row so far (LOCKED)
+
+    uint64_t stream_pos;                    // position in the bitstream of data[0] of the current chunk
+
+    // called on lock / loss of lock - stream_pos is the position in the bitstream of the frame that caused it
+    void (*event)( void *arg, int event, uint64_t stream_pos );
+    void *event_arg;
+
+    // statistics
+    uint64_t lock_count;
+    uint64_t loss_count;
+    uint64_t flywheel_count;                // # of frames decoded at the expected offset without a valid sync pair
+} oob_sync_tracker;
+
+
+//------------
+// PID filter
+//------------
+
+#define OOB_PID_COUNT           8192        // PIDs are 13 bits
+#define OOB_PID_MAX_ROUTES      256         // outputs oob_pid_route_run() can tell apart (route 0 is the main output)
+
+// which PIDs the decoder passes on, and the output each of them goes to
+// a decoder with a filter drops every packet whose PID isn't set as it is emitted - it is overwritten by the next packet
+// instead of being copied anywhere, the packets kept are packed together in decode order
+// one filter can be shared by any number of decoders, they only read it
+typedef struct oob_pid_filter
+{
+    uint64_t pass[OOB_PID_COUNT/64];        // 1 bit per PID - set = the packet is kept
+    uint8_t route[OOB_PID_COUNT];           // output # of each PID kept - 0 = the main output
+} oob_pid_filter;
+
+
+// PID of the 188-byte TS packet at ts[]
+static inline int oob_ts_pid( const uint8_t *ts )
+{
+    return ((ts[1] & 0x1F) << 8) | ts[2];
+}
+
+
+static inline int oob_pid_passes( const oob_pid_filter *f, int pid )
+{
+    return (f->pass[pid >> 6] >> (pid & 63)) & 1;
+}
+
+
+// set up a filter that passes nothing
+void oob_pid_filter_init( oob_pid_filter *f );
+
+
+// pass packets with this PID, to output # route
+void oob_pid_filter_add( oob_pid_filter *f, int pid, int route );
+
+
+// keep the npackets TS packets at ts[] that the filter passes, packed together at the start of ts[] in the same order
+// return value: # of packets kept
+int oob_pid_filter_packets( const oob_pid_filter *f, uint8_t *ts, int npackets );
+
+
+// how many of the npackets TS packets at ts[] in a row go to the same output as the first one - *route is set to that output
+// packets of PIDs the filter doesn't pass go to output 0
+// return value: # of packets (at least 1 if npackets > 0)
+int oob_pid_route_run( const oob_pid_filter *f, const uint8_t *ts, int npackets, int *route );
+
+
+//-----------------
+// Decoder context
+//-----------------
+
+// all state of one decoder - use one oob_decoder per bitstream being decoded
+// decoders share nothing but the read-only GF tables (and a PID filter, if given one), so several can run at once (on separate threads)
+typedef struct oob_decoder
+{
+    int do_fec;                             // 0 = FEC bytes are ignored, 1 = FEC is checked and repair attempted
+
+    struct oob_frame_pool *pool;            // threads for parallel frame decoding - NULL = frames are decoded serially
+
+    RS_STATE rs;                            // Reed Solomon decoder state (syndromes, error locator polynomial, ...)
+
+    oob_sync_tracker sync;                  // frame sync state - carried from one chunk to the next
+
+    const oob_pid_filter *pid_filter;       // NULL = every packet is output, else only the PIDs it passes
+
+    // statistics - 64-bit, so a feed decoded for months doesn't wrap them
+    // only the thread decoding with the decoder writes them (plain increments), the metrics exporter reads them as they
+    // change (see metrics.h) - oob_decoder_merge_stats() is how other threads' counts are added in
+    uint64_t fec_error_count;               // # of blocks with a non-zero syndrome
+    uint64_t fec_total_block_count;         // # of 96-byte FEC blocks processed (1 TS packet = 2 FEC blocks)
+    uint64_t fec_corrected_block_count;
+    uint64_t fec_erasure_block_count;       // # of the corrected blocks that needed the erasure flags (2 symbols repaired)
+    uint64_t fec_ambiguous_block_count;     // # of blocks with 2 flagged symbols whose syndromes also fit 1 unflagged error (left uncorrected)
+
+    uint64_t pid_dropped_count;             // # of packets dropped by pid_filter
+
+    uint64_t in_byte_count;                 // # of bitstream bytes taken in (counted by whatever feeds the decoder)
+    uint64_t frame_count;                   // # of 384-byte frames decoded
+    uint64_t out_packet_count;              // # of TS packets output, after pid_filter
+    uint64_t tei_packet_count;              // # of TS packets decoded with the TEI set - FEC couldn't repair them
+
+#ifdef OOB_PROFILE
+    oob_profile prof;                       // per-stage cycle counters
+#endif
+} oob_decoder;
+
+
+// initialize a decoder context - must be called before the context is passed to any other oob_ function
+// if do_fec is 0 then FEC bytes will be ignored.  if do_fec==1 then FEC will be checked and repair attempted
+void oob_decoder_init( oob_decoder *dec, int do_fec );
+
+
+// add the frame, packet and FEC counters of src to dst and clear them in src (the sync tracker's and in_byte_count stay)
+// the additions are atomic, so several threads can merge into one dst while it is being read
+void oob_decoder_merge_stats( oob_decoder *dst, oob_decoder *src );
+
+
+// build the shared GF tables and generator polynomial (once) - used by decoders with FEC and by the encoder
+void oob_ecc_init( void );
+
+
+// decode the frames of each chunk on nthreads threads (the thread calling oob_process_data_chunk() is one of them)
+// nthreads <= 1 stops the threads and goes back to serial decoding
+// return value: 0 if successful, negative value if the threads could not be started (the decoder stays serial)
+int oob_decoder_set_threads( oob_decoder *dec, int nthreads );
+
+
+// release everything oob_decoder_set_threads() set up - the context can be reused after another oob_decoder_init()
+void oob_decoder_free( oob_decoder *dec );
 
 
 //-----------------------------------------------------
@@ -35,6 +188,11 @@ extern int fec_corrected_block_count;
 int oob_de_interleaver( uint8_t *data_in, uint8_t *data_out );
 
 
+// de-interleave all four 96-byte blocks of a frame in one call (vectorized when the CPU supports it)
+// data_in[] must contain at least 1152 bytes, frame_out[] gets the 384-byte de-interleaved frame
+void oob_de_interleave_frame( uint8_t *data_in, uint8_t *frame_out );
+
+
 //-------------------------
 // 2. Reed Solomon Decoder
 //-------------------------
@@ -65,7 +223,29 @@ int oob_de_interleaver( uint8_t *data_in, uint8_t *data_out );
 
 // works over 96-byte blocks (runs twice for each ts packet)
 // return value: 0 if successful - this 96-byte block is valid
-int oob_de_fec( uint8_t *data_in );
+int oob_de_fec( oob_decoder *dec, uint8_t *data_in );
+
+
+// oob_de_fec() with erasure flags from the demodulator - erasures[] is aligned with the de-interleaved 96-byte block,
+// a non-zero byte marks a low-confidence symbol
+// T=1 can only correct 1 unknown error, but 2 errors whose positions are known (erasures): if exactly 2 symbols of the
+// block are flagged they are solved for directly, otherwise the flags are not used and this is oob_de_fec()
+// nothing is left to check a 2-erasure solution with, so if the syndromes could just as well be a single error at an
+// unflagged symbol the block is not corrected (negative return value, counted in fec_ambiguous_block_count)
+// erasures[] may be NULL
+// return value: 0 if the block is valid, 1 if one error was corrected, 2 if two erasures were filled in, negative value if unrecoverable
+int oob_de_fec_erasures( oob_decoder *dec, uint8_t *data_in, const uint8_t *erasures );
+
+
+#define OOB_FEC_BATCH_FRAMES    16          // frames oob_decode_frame_batch() checks with one oob_de_fec_batch() call
+#define OOB_FEC_BATCH_BLOCKS    64          // blocks whose syndromes oob_de_fec_batch() computes in one pass
+
+// FEC check and repair of nblocks 96-byte blocks, stride bytes apart from blocks[] - all syndromes are computed first,
+// one block per vector lane, then only the blocks with errors are corrected
+// erasures[] is NULL, or the flags of each block (stride bytes apart like the blocks)
+// status[k] gets what oob_de_fec_erasures() would have returned for block k
+// return value: # of blocks that are still corrupt (status < 0)
+int oob_de_fec_batch( oob_decoder *dec, uint8_t *blocks, const uint8_t *erasures, int stride, int nblocks, int8_t *status );
 
 
 //-----------------
@@ -73,15 +253,19 @@ int oob_de_fec( uint8_t *data_in );
 //-----------------
 
 // works over 384-byte blocks (2x ts packets)
-// len is number of bytes to de_randomize - usually this is 384, but less is accepted
+// len is number of bytes to de_randomize - usually this is 384, but any length is accepted (ie: a single 188-byte ts packet)
 // frame_pos is the position within 384-byte randomizer frame  (ie: 192 if de_randomizing 2nd ts packet alone)
 // return value: 0 if successful
 int oob_de_randomizer( uint8_t *data, int len, int frame_pos );
 
 
+// oob_rand_table[] with the 8 positions gated out of the randomizing action (RS parity bytes) set to 0
+extern const uint8_t oob_rand_mask[384];
+
+
 // 384-byte table of XOR values used for TS randomization
 // oob_rand_table[] can be calculated by oob_calc_rand_table()  (or it can be precalculated and included at compile time)
-const uint8_t oob_rand_table[384];
+extern const uint8_t oob_rand_table[384];
 
 
 // to calculate const uint8_t rand_table[] use oob_calc_rand_table()
@@ -89,6 +273,21 @@ const uint8_t oob_rand_table[384];
 void oob_calc_rand_table( uint8_t *table );
 
 
+//---------------------------------
+// 4. Drop parity bytes / fused kernels
+//---------------------------------
+
+// 1. + 3. + 4. in a single pass - de-interleave, derandomize and drop the parity bytes of a whole frame
+// data_in[] is the interleaved bitstream starting at a frame sync byte - it must contain at least 1152 bytes (like oob_de_interleaver())
+// writes 2x 188-byte TS packets (376 bytes) to ts_out[] - used when FEC is not checked
+void oob_de_frame( uint8_t *data_in, uint8_t *ts_out );
+
+
+// 3. + 4. in a single pass - derandomize a de-interleaved 384-byte frame and drop its parity bytes
+// writes 2x 188-byte TS packets (376 bytes) to ts_out[] - used after the FEC blocks of the frame have been checked
+void oob_de_randomize_frame( uint8_t *frame, uint8_t *ts_out );
+
+
 //-----------------
 // Other functions
 //-----------------
@@ -97,11 +296,66 @@ void oob_calc_rand_table( uint8_t *table );
 int oob_synchronize_bitstream( uint8_t *data, int start_ofs, int len );
 
 
+// sync tracker - find the next frame to decode at or after data[i], the frame expected there if locked
+// sync->stream_pos must be the position in the bitstream of data[0] (only used for the events)
+// return value: offset of the frame in data[], -1 if there is no frame with 1152 bytes behind it before the end of data[]
+//               - *resume is then the offset to carry over to the next chunk
+int oob_sync_next_frame( oob_sync_tracker *sync, uint8_t *data, int i, int len, int *resume );
+
+
+// find the frames oob_process_data_chunk() would decode in data[] and where it would stop - without modifying data[]
+// advances the sync tracker of dec past the frames found, exactly like oob_process_data_chunk() does
+// if frame_ofs is not NULL the offset of each frame found is stored in frame_ofs[] (room for len/384 entries) and the count in *nframes
+// return value: number of bytes at the start of data[] that oob_process_data_chunk() consumes, the rest is what it would return as remaining
+int oob_scan_data_chunk( oob_decoder *dec, uint8_t *data, int len, int *frame_ofs, int *nframes );
+
+
+// decode one synchronized 384-byte frame (2 TS packets) - data[0] is a 0x47 sync byte, data[192] is a 0x64 sync byte
+// data[] must contain at least 1152 bytes, it is not modified
+// writes 2x 188-byte TS packets (376 bytes) to ts_out[]
+// return value: 0 if successful
+int oob_decode_frame( oob_decoder *dec, uint8_t *data, uint8_t *ts_out );
+
+
+// oob_decode_frame() with erasure flags - flags[] is aligned with the bitstream in data[] (1152 bytes, a non-zero byte marks a
+// low-confidence byte from the demodulator), it is de-interleaved in step with the data to give the erasures of each block
+// flags may be NULL (no erasures), the flags are not used if dec->do_fec is 0
+int oob_decode_frame_erasures( oob_decoder *dec, uint8_t *data, uint8_t *flags, uint8_t *ts_out );
+
+
+// decode nframes frames - frame k (at data + frame_ofs[k]) to ts_out + k*376 - with one oob_de_fec_batch() call for the
+// blocks of each OOB_FEC_BATCH_FRAMES frames - the same output as oob_decode_frame_erasures() on each frame
+void oob_decode_frame_batch( oob_decoder *dec, uint8_t *data, uint8_t *flags, int *frame_ofs, int nframes, uint8_t *ts_out );
+
+
+// decode the nframes frames found by oob_scan_data_chunk() into ts_out[] (room for nframes*376 bytes)
+// without a PID filter frame k (at data + frame_ofs[k]) is written to ts_out + k*376, with one the packets it passes are
+// packed together at the start of ts_out[]
+// flags[] is NULL, or erasure flags aligned with data[] (see oob_decode_frame_erasures())
+// the frames are decoded on the threads of dec->pool if there are any
+// return value: # of 188-byte TS packets placed in ts_out[]
+int oob_decode_frames( oob_decoder *dec, uint8_t *data, uint8_t *flags, int *frame_ofs, int nframes, uint8_t *ts_out );
+
+
+// decode all frames in data[] on the threads of dec->pool - used by oob_process_data_chunk()
+// return value: number of bytes at the start of data[] consumed, negative value if the frames could not be decoded in parallel
+int oob_parallel_process_data_chunk( oob_decoder *dec, uint8_t *data, int len, uint8_t *ts_out, int *out_len );
+
+
+// decode the frames at frame_ofs[] on the threads of dec->pool - used by oob_decode_frames()
+void oob_parallel_decode_frames( oob_decoder *dec, uint8_t *data, uint8_t *flags, int *frame_ofs, int nframes, uint8_t *ts_out );
+
+
+// apply dec->pid_filter to npackets decoded TS packets at ts[] - keeps count of the packets dropped
+// return value: # of packets kept, packed together at the start of ts[]
+int oob_decoder_filter_packets( oob_decoder *dec, uint8_t *ts, int npackets );
+
+
 // process len bytes in data
-// int *out_len is # of processed data bytes that have been put in ts_out[]
+// int *out_len is # of processed data bytes that have been put in ts_out[] - only the packets dec->pid_filter passes, if it is set
 // return value: 0 or positive value if successful, return value is number of bytes remaining *data that have not been processed
 // return value is negative in case of error
-int oob_process_data_chunk( uint8_t *data, int len, uint8_t *ts_out, int *out_len, int do_fec );
+int oob_process_data_chunk( oob_decoder *dec, uint8_t *data, int len, uint8_t *ts_out, int *out_len );
 
 
 #endif  // _OOBIN_H
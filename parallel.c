@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "oobin.h"
+
+
+//---------------------------------
+// Parallel frame decoding in a chunk
+//---------------------------------
+//
+// oob_scan_data_chunk() finds every frame of the chunk first - the sync positions only depend on the raw bitstream and
+// the sync tracker, so this is exactly the list of frames the serial loop would decode, including any bytes skipped
+// after loss of sync and any frames flywheeled through while locked
+// the frames are then shared out between the pool threads and the calling thread:
+// each thread claims the next OOB_POOL_BATCH frames from a shared atomic counter until none are left, so a thread that
+// finishes early keeps taking work from the others instead of idling on a fixed split
+// frame k is always written to ts_out + k*376, so the output is in order no matter which thread decoded it
+
+
+#define OOB_POOL_BATCH          OOB_FEC_BATCH_FRAMES    // frames claimed at a time - one FEC batch
+#define OOB_POOL_MIN_FRAMES     (2*OOB_POOL_BATCH)  // smaller chunks are decoded by the calling thread alone
+
+
+typedef struct oob_pool_thread
+{
+    pthread_t thread;
+    oob_decoder decoder;                    // own FEC state and statistics, added to the owning decoder after each chunk
+    struct oob_frame_pool *pool;
+} oob_pool_thread;
+
+
+typedef struct oob_frame_pool
+{
+    oob_pool_thread *helper;                // the threads besides the one calling oob_process_data_chunk()
+    int nhelpers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;                   // signalled when a new chunk is ready (or the pool is stopping)
+    pthread_cond_t done;                    // signalled when the last helper finishes a chunk
+    unsigned generation;                    // incremented for each chunk
+    int busy;                               // # of helpers still working on the current chunk
+    int quit;
+
+    // current chunk
+    uint8_t *data;
+    uint8_t *flags;                         // erasure flags aligned with data[], NULL if there are none
+    uint8_t *ts_out;
+    int *frame_ofs;
+    int nframes;
+
+    int *frame_buf;                         // frame list of oob_parallel_process_data_chunk()
+    int frame_buf_size;
+    atomic_int next_frame;
+} oob_frame_pool;
+
+
+// decode frames claimed from the shared counter until all frames of the chunk are taken
+static void oob_pool_decode_frames( oob_frame_pool *pool, oob_decoder *dec )
+{
+    int k;
+    int end;
+
+
+    while( (k = atomic_fetch_add( &pool->next_frame, OOB_POOL_BATCH )) < pool->nframes )
+    {
+        end = k + OOB_POOL_BATCH;
+        if( end > pool->nframes )
+            end = pool->nframes;
+
+        oob_decode_frame_batch( dec, pool->data, pool->flags, pool->frame_ofs + k, end - k, pool->ts_out + k*376 );
+    }
+}
+
+
+static void *oob_pool_thread_main( void *arg )
+{
+    oob_pool_thread *t = (oob_pool_thread *)arg;
+    oob_frame_pool *pool = t->pool;
+    unsigned generation = 0;
+
+
+    for( ;; )
+    {
+        pthread_mutex_lock( &pool->lock );
+        while( !pool->quit && pool->generation == generation )
+            pthread_cond_wait( &pool->start, &pool->lock );
+        if( pool->quit )
+        {
+            pthread_mutex_unlock( &pool->lock );
+            break;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock( &pool->lock );
+
+        oob_pool_decode_frames( pool, &t->decoder );
+
+        pthread_mutex_lock( &pool->lock );
+        if( --pool->busy == 0 )
+            pthread_cond_signal( &pool->done );
+        pthread_mutex_unlock( &pool->lock );
+    }
+
+
+    return NULL;
+}
+
+
+static void oob_pool_stop( oob_frame_pool *pool )
+{
+    int n;
+
+
+    pthread_mutex_lock( &pool->lock );
+    pool->quit = 1;
+    pthread_cond_broadcast( &pool->start );
+    pthread_mutex_unlock( &pool->lock );
+
+    for( n=0; n<pool->nhelpers; n++ )
+        pthread_join( pool->helper[n].thread, NULL );
+
+    pthread_mutex_destroy( &pool->lock );
+    pthread_cond_destroy( &pool->start );
+    pthread_cond_destroy( &pool->done );
+    free( pool->helper );
+    free( pool->frame_buf );
+    free( pool );
+}
+
+
+// decode the frames of each chunk on nthreads threads (the thread calling oob_process_data_chunk() is one of them)
+// nthreads <= 1 stops the threads and goes back to serial decoding
+// return value: 0 if successful, negative value if the threads could not be started (the decoder stays serial)
+int oob_decoder_set_threads( oob_decoder *dec, int nthreads )
+{
+    oob_frame_pool *pool;
+    int n;
+
+
+    if( dec->pool )
+    {
+        oob_pool_stop( dec->pool );
+        dec->pool = NULL;
+    }
+
+    if( nthreads <= 1 )
+        return 0;
+
+    pool = (oob_frame_pool *)calloc( 1, sizeof(oob_frame_pool) );
+    if( !pool )
+        return -1;
+    pool->helper = (oob_pool_thread *)calloc( nthreads-1, sizeof(oob_pool_thread) );
+    if( !pool->helper )
+    {
+        free( pool );
+        return -1;
+    }
+
+    pthread_mutex_init( &pool->lock, NULL );
+    pthread_cond_init( &pool->start, NULL );
+    pthread_cond_init( &pool->done, NULL );
+    atomic_init( &pool->next_frame, 0 );
+
+    for( n=0; n<nthreads-1; n++ )
+    {
+        oob_decoder_init( &pool->helper[n].decoder, dec->do_fec );
+        pool->helper[n].pool = pool;
+        if( pthread_create( &pool->helper[n].thread, NULL, oob_pool_thread_main, &pool->helper[n] ) )
+            break;
+        pool->nhelpers++;
+    }
+
+    if( pool->nhelpers < nthreads-1 )
+    {
+        oob_pool_stop( pool );
+        return -2;
+    }
+
+    dec->pool = pool;
+
+
+    return 0;
+}
+
+
+// release everything oob_decoder_set_threads() set up - the context can be reused after another oob_decoder_init()
+void oob_decoder_free( oob_decoder *dec )
+{
+    oob_decoder_set_threads( dec, 0 );
+}
+
+
+// decode all frames in data[] on the threads of dec->pool - used by oob_process_data_chunk()
+// return value: number of bytes at the start of data[] consumed, negative value if the frames could not be decoded in parallel
+int oob_parallel_process_data_chunk( oob_decoder *dec, uint8_t *data, int len, uint8_t *ts_out, int *out_len )
+{
+    oob_frame_pool *pool = dec->pool;
+    int *frame_buf;
+    int consumed;
+    int nframes;
+
+
+    if( pool->frame_buf_size < len/384 + 1 )
+    {
+        frame_buf = (int *)realloc( pool->frame_buf, (len/384 + 1) * sizeof(int) );
+        if( !frame_buf )
+            return -1;
+        pool->frame_buf = frame_buf;
+        pool->frame_buf_size = len/384 + 1;
+    }
+
+    consumed = oob_scan_data_chunk( dec, data, len, pool->frame_buf, &nframes );
+
+    oob_parallel_decode_frames( dec, data, NULL, pool->frame_buf, nframes, ts_out );
+
+    *out_len = 188 * oob_decoder_filter_packets( dec, ts_out, 2*nframes );
+
+
+    return consumed;
+}
+
+
+// decode the frames at frame_ofs[] on the threads of dec->pool - used by oob_decode_frames()
+void oob_parallel_decode_frames( oob_decoder *dec, uint8_t *data, uint8_t *flags, int *frame_ofs, int nframes, uint8_t *ts_out )
+{
+    oob_frame_pool *pool = dec->pool;
+    oob_decoder *helper;
+    int n;
+
+
+    pool->data = data;
+    pool->flags = flags;
+    pool->ts_out = ts_out;
+    pool->frame_ofs = frame_ofs;
+    pool->nframes = nframes;
+    atomic_store( &pool->next_frame, 0 );
+
+    if( pool->nframes < OOB_POOL_MIN_FRAMES )
+    {   // not worth waking the helpers up
+        oob_pool_decode_frames( pool, dec );
+        return;
+    }
+
+    pthread_mutex_lock( &pool->lock );
+    pool->busy = pool->nhelpers;
+    pool->generation++;
+    pthread_cond_broadcast( &pool->start );
+    pthread_mutex_unlock( &pool->lock );
+
+    oob_pool_decode_frames( pool, dec );
+
+    pthread_mutex_lock( &pool->lock );
+    while( pool->busy > 0 )
+        pthread_cond_wait( &pool->done, &pool->lock );
+    pthread_mutex_unlock( &pool->lock );
+
+    for( n=0; n<pool->nhelpers; n++ )
+    {
+        helper = &pool->helper[n].decoder;
+
+        oob_decoder_merge_stats( dec, helper );
+
+#ifdef OOB_PROFILE
+        oob_prof_merge( &dec->prof, &helper->prof );
+#endif
+    }
+}
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "pipeline.h"
+#include "ring.h"
+#include "arena.h"
+
+
+// end-of-stream marker passed down the rings after the last chunk
+static oob_chunk oob_eof_chunk;
+
+
+typedef struct oob_worker
+{
+    pthread_t thread;
+    oob_decoder decoder;
+    oob_ring in;                        // chunks from the reader
+    oob_ring out;                       // decoded chunks to the writer
+    struct oob_pipeline *pipeline;
+} oob_worker;
+
+
+typedef struct oob_pipeline
+{
+    FILE *InFile;
+    FILE *OutFile;
+    int chunk_bytes;
+    oob_decoder *sync;                  // decoder whose sync tracker the reader follows the bitstream with
+
+    oob_chunk *chunks;                  // all chunk buffers
+    int nchunks;
+    oob_arena buffers;                  // the in[] and out[] of every chunk, one after the other
+    oob_ring free_ring;                 // empty chunk buffers, writer -> reader
+
+    oob_worker *worker;
+    int nworkers;
+
+    atomic_int abort;                   // set by any thread on error - the others stop working and drain
+} oob_pipeline;
+
+
+static void *oob_pipeline_reader( void *arg )
+{
+    oob_pipeline *p = (oob_pipeline *)arg;
+    oob_chunk *chunk;
+    oob_chunk *next;
+    uint64_t seq = 0;
+    int BytesRead;
+    int cut;
+    int n;
+
+
+    chunk = (oob_chunk *)oob_ring_pop_wait( &p->free_ring );
+    chunk->in_len = 0;
+
+    while( !atomic_load( &p->abort ) )
+    {
+        OOB_PROF_START( t );
+        BytesRead = fread( chunk->in + chunk->in_len, 1, p->chunk_bytes - chunk->in_len, p->InFile );
+        if( BytesRead < 1 )
+            break;
+        chunk->in_len += BytesRead;
+        p->sync->in_byte_count += BytesRead;
+        OOB_PROF_LAP( &p->sync->prof, OOB_PROF_READ, t, BytesRead );
+
+        cut = oob_scan_data_chunk( p->sync, chunk->in, chunk->in_len, chunk->frame_ofs, &chunk->nframes );
+
+        if( feof(p->InFile) || ferror(p->InFile) )
+        {   // last chunk - decode all of it
+            oob_ring_push_wait( &p->worker[seq++ % p->nworkers].in, chunk );
+            break;
+        }
+
+        if( cut == 0 )
+        {
+            if( chunk->in_len == p->chunk_bytes )
+                break;      // no room to read more and nothing to decode - the single-threaded loop stops here as well
+            continue;
+        }
+
+        // the bytes past the cut start the next chunk - the worker still reads up to 768 of them (de-interleaver span)
+        next = (oob_chunk *)oob_ring_pop_wait( &p->free_ring );
+        next->in_len = chunk->in_len - cut;
+        memcpy( next->in, chunk->in + cut, next->in_len );
+
+        oob_ring_push_wait( &p->worker[seq++ % p->nworkers].in, chunk );
+        chunk = next;
+    }
+
+    for( n=0; n<p->nworkers; n++ )
+        oob_ring_push_wait( &p->worker[n].in, &oob_eof_chunk );
+
+
+    return NULL;
+}
+
+
+static void *oob_pipeline_decoder( void *arg )
+{
+    oob_worker *w = (oob_worker *)arg;
+    oob_chunk *chunk;
+
+
+    while( (chunk = (oob_chunk *)oob_ring_pop_wait( &w->in )) != &oob_eof_chunk )
+    {
+        chunk->out_len = 0;
+
+        if( !atomic_load( &w->pipeline->abort ) )
+        {
+            chunk->out_len = 188 * oob_decode_frames( &w->decoder, chunk->in, NULL, chunk->frame_ofs, chunk->nframes, chunk->out );
+            // straight into the shared statistics, so they are live while the pipeline runs
+            oob_decoder_merge_stats( w->pipeline->sync, &w->decoder );
+        }
+
+        oob_ring_push_wait( &w->out, chunk );
+    }
+
+    oob_ring_push_wait( &w->out, &oob_eof_chunk );
+
+
+    return NULL;
+}
+
+
+static void *oob_pipeline_writer( void *arg )
+{
+    oob_pipeline *p = (oob_pipeline *)arg;
+    oob_chunk *chunk;
+    uint64_t seq = 0;
+    int BytesWritten;
+
+
+    // chunks were handed out round-robin, collecting them round-robin puts them back in order
+    while( (chunk = (oob_chunk *)oob_ring_pop_wait( &p->worker[seq++ % p->nworkers].out )) != &oob_eof_chunk )
+    {
+        if( chunk->out_len > 0 && !atomic_load( &p->abort ) )
+        {
+            OOB_PROF_START( t );
+            BytesWritten = fwrite( chunk->out, 1, chunk->out_len, p->OutFile );
+            OOB_PROF_LAP( &p->sync->prof, OOB_PROF_WRITE, t, BytesWritten );
+            if( BytesWritten < chunk->out_len )
+            {
+                fprintf( stderr, "Error writing output file - %d / %d bytes written.\n", BytesWritten, chunk->out_len );
+                atomic_store( &p->abort, 1 );
+            }
+        }
+
+        oob_ring_push_wait( &p->free_ring, chunk );
+    }
+
+
+    return NULL;
+}
+
+
+// decode InFile into OutFile using a reader thread, workers decode threads and a writer thread
+// chunk_bytes is the size of each chunk buffer (the same as the single-threaded read size)
+// queue_depth is the # of chunk buffers in flight per decode thread
+// frame_threads is passed to oob_decoder_set_threads() for each decode worker (1 = each worker decodes its chunks serially)
+// the frame, packet and FEC counters of all workers are added to *stats as each chunk is decoded, so they are live while
+// the pipeline runs (*stats must have been set up by oob_decoder_init() with do_fec)
+// the sync tracker of *stats is used by the reader thread - its settings apply and its event callback is called from that thread
+// return value: 0 if successful, negative value in case of error
+int oob_pipeline_run( FILE *InFile, FILE *OutFile, int chunk_bytes, int workers, int queue_depth, int frame_threads, oob_decoder *stats )
+{
+    oob_pipeline p;
+    pthread_t reader;
+    pthread_t writer;
+    size_t stride;
+    int nstarted = 0;
+    int writer_started = 0;
+    int reader_started = 0;
+    int ret = -1;
+    int n;
+
+
+    memset( &p, 0, sizeof(p) );
+    p.InFile = InFile;
+    p.OutFile = OutFile;
+    p.chunk_bytes = chunk_bytes;
+    p.sync = stats;
+    p.nworkers = workers > 0 ? workers : 1;
+    p.nchunks = p.nworkers * (queue_depth > 0 ? queue_depth : 1);
+    if( p.nchunks < 2 )
+        p.nchunks = 2;      // the reader holds one chunk while it fills the next
+    atomic_init( &p.abort, 0 );
+
+    p.chunks = (oob_chunk *)calloc( p.nchunks, sizeof(oob_chunk) );
+    p.worker = (oob_worker *)calloc( p.nworkers, sizeof(oob_worker) );
+    if( !p.chunks || !p.worker )
+    {
+        fprintf( stderr, "Error - unable to allocate pipeline - aborting.\n" );
+        goto end_free;
+    }
+
+    // every ring can hold all chunks, so a push never has to wait for a slow consumer on another ring
+    if( oob_ring_init( &p.free_ring, p.nchunks ) )
+        goto end_free;
+
+    // output is never larger than the input (376 of every 384 bytes) - each buffer starts on a cache line
+    stride = (chunk_bytes + OOB_ARENA_ALIGN - 1) & ~(size_t)(OOB_ARENA_ALIGN - 1);
+    if( oob_arena_alloc( &p.buffers, 2 * stride * p.nchunks ) < 0 )
+    {
+        fprintf( stderr, "Error - unable to allocate %zu bytes of chunk buffers - aborting.\n", 2 * stride * p.nchunks );
+        goto end_free;
+    }
+
+    for( n=0; n<p.nchunks; n++ )
+    {
+        p.chunks[n].in = p.buffers.base + 2*n * stride;
+        p.chunks[n].out = p.buffers.base + (2*n + 1) * stride;
+        p.chunks[n].frame_ofs = (int *)malloc( (chunk_bytes/384 + 1) * sizeof(int) );
+        if( !p.chunks[n].frame_ofs )
+        {
+            fprintf( stderr, "Error - unable to malloc(%d) chunk buffers - aborting.\n", chunk_bytes );
+            goto end_free;
+        }
+        oob_ring_push( &p.free_ring, &p.chunks[n] );
+    }
+
+    for( n=0; n<p.nworkers; n++ )
+    {
+        oob_decoder_init( &p.worker[n].decoder, stats->do_fec );
+        p.worker[n].decoder.pid_filter = stats->pid_filter;
+        if( oob_decoder_set_threads( &p.worker[n].decoder, frame_threads ) < 0 )
+            fprintf( stderr, "Unable to start %d frame decoding threads for decode thread %d - it decodes serially.\n", frame_threads, n );
+        p.worker[n].pipeline = &p;
+        if( oob_ring_init( &p.worker[n].in, p.nchunks ) || oob_ring_init( &p.worker[n].out, p.nchunks ) )
+            goto end_free;
+    }
+
+
+    for( ; nstarted<p.nworkers; nstarted++ )
+    {
+        if( pthread_create( &p.worker[nstarted].thread, NULL, oob_pipeline_decoder, &p.worker[nstarted] ) )
+            break;
+    }
+    if( nstarted == p.nworkers && !pthread_create( &writer, NULL, oob_pipeline_writer, &p ) )
+    {
+        writer_started = 1;
+        if( !pthread_create( &reader, NULL, oob_pipeline_reader, &p ) )
+            reader_started = 1;
+    }
+
+    if( reader_started )
+        pthread_join( reader, NULL );
+    else
+    {   // the threads that did start wait for an end of stream the reader won't send - send it for it (the writer stops
+        // at the first decode thread's)
+        fprintf( stderr, "Error - unable to start pipeline threads - aborting.\n" );
+        for( n=0; n<nstarted; n++ )
+            oob_ring_push_wait( &p.worker[n].in, &oob_eof_chunk );
+    }
+    if( writer_started )
+        pthread_join( writer, NULL );
+    for( n=0; n<nstarted; n++ )
+    {
+        pthread_join( p.worker[n].thread, NULL );
+#ifdef OOB_PROFILE
+        oob_prof_merge( &stats->prof, &p.worker[n].decoder.prof );
+#endif
+    }
+
+    if( reader_started )
+        ret = atomic_load( &p.abort ) ? -2 : 0;
+
+
+end_free:
+    if( p.worker )
+    {
+        for( n=0; n<p.nworkers; n++ )
+        {
+            oob_decoder_free( &p.worker[n].decoder );
+            oob_ring_free( &p.worker[n].in );
+            oob_ring_free( &p.worker[n].out );
+        }
+    }
+    if( p.chunks )
+    {
+        for( n=0; n<p.nchunks; n++ )
+            free( p.chunks[n].frame_ofs );
+    }
+    oob_arena_free( &p.buffers );
+    oob_ring_free( &p.free_ring );
+    free( p.worker );
+    free( p.chunks );
+
+
+    return ret;
+}
@@ -0,0 +1,48 @@
+#ifndef _PIPELINE_H
+#define _PIPELINE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "oobin.h"
+
+
+//---------------------------------------
+// Reader / decoder / writer thread pipeline
+//---------------------------------------
+//
+// reader thread  - fread()s the input into fixed-size chunk buffers, finds the frames in them with oob_scan_data_chunk()
+//                  (the one sync tracker follows the whole bitstream), cuts them at the same frame boundaries
+//                  oob_process_data_chunk() would stop at, and hands them out round-robin to the decode workers
+// decode workers - each decodes the frames found in its chunks with oob_decode_frames() and its own oob_decoder
+// writer thread  - collects the chunks back in the order they were read and fwrite()s the TS output
+//
+// chunks are passed between the threads through bounded lock-free SPSC rings (ring.h):
+// reader -> each worker, each worker -> writer, and writer -> reader for the empty chunk buffers
+// the output is byte-identical to the single-threaded fread/oob_process_data_chunk/fwrite loop
+
+
+// one chunk of input data and the TS output decoded from it
+typedef struct oob_chunk
+{
+    uint8_t *in;
+    int in_len;                         // # of bytes in in[]
+    int *frame_ofs;                     // offsets of the frames in in[] found by the reader
+    int nframes;
+    uint8_t *out;
+    int out_len;                        // # of bytes placed in out[] by oob_decode_frames()
+} oob_chunk;
+
+
+// decode InFile into OutFile using a reader thread, workers decode threads and a writer thread
+// chunk_bytes is the size of each chunk buffer (the same as the single-threaded read size)
+// queue_depth is the # of chunk buffers in flight per decode thread
+// frame_threads is passed to oob_decoder_set_threads() for each decode worker (1 = each worker decodes its chunks serially)
+// the frame, packet and FEC counters of all workers are added to *stats as each chunk is decoded, so they are live while
+// the pipeline runs (*stats must have been set up by oob_decoder_init() with do_fec)
+// the sync tracker of *stats is used by the reader thread - its settings apply and its event callback is called from that thread
+// return value: 0 if successful, negative value in case of error
+int oob_pipeline_run( FILE *InFile, FILE *OutFile, int chunk_bytes, int workers, int queue_depth, int frame_threads, oob_decoder *stats );
+
+
+#endif  // _PIPELINE_H
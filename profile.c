@@ -0,0 +1,106 @@
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "profile.h"
+
+
+#ifdef OOB_PROFILE
+
+static const char *oob_prof_stage_name[OOB_PROF_STAGES] =
+{
+    "sync",
+    "de-interleave",
+    "fec",
+    "derandomize",
+    "de_frame",
+    "read",
+    "write",
+};
+
+#endif  // OOB_PROFILE
+
+
+// add the counters of src to dst and clear src
+void oob_prof_merge( oob_profile *dst, oob_profile *src )
+{
+    int n;
+
+
+    for( n=0; n<OOB_PROF_STAGES; n++ )
+    {
+        dst->cycles[n] += src->cycles[n];
+        dst->calls[n] += src->calls[n];
+        dst->bytes[n] += src->bytes[n];
+    }
+
+    memset( src, 0, sizeof(*src) );
+}
+
+
+#ifdef OOB_PROFILE
+
+static pthread_once_t oob_prof_once = PTHREAD_ONCE_INIT;
+static double oob_prof_hz;                  // oob_prof_now() ticks per second
+
+
+static double oob_prof_seconds( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+// count ticks over 20 ms of CLOCK_MONOTONIC
+static void oob_prof_calibrate( void )
+{
+    struct timespec delay = { 0, 20000000 };
+    uint64_t t0, t1;
+    double s0, s1;
+
+
+    s0 = oob_prof_seconds();
+    t0 = oob_prof_now();
+    nanosleep( &delay, NULL );
+    s1 = oob_prof_seconds();
+    t1 = oob_prof_now();
+
+    oob_prof_hz = (t1 - t0) / (s1 - s0);
+}
+
+#endif  // OOB_PROFILE
+
+
+// print a per-stage breakdown - calls, cycles, cycles per call and bytes/sec while in the stage
+void oob_prof_report( FILE *f, const oob_profile *prof )
+{
+#ifdef OOB_PROFILE
+    uint64_t total = 0;
+    double seconds;
+    int n;
+
+
+    pthread_once( &oob_prof_once, oob_prof_calibrate );
+
+    for( n=0; n<OOB_PROF_STAGES; n++ )
+        total += prof->cycles[n];
+
+    fprintf( f, "%-14s %12s %16s %10s %7s %12s\n", "stage", "calls", "cycles", "cyc/call", "share", "MB/s" );
+    for( n=0; n<OOB_PROF_STAGES; n++ )
+    {
+        if( !prof->calls[n] )
+            continue;
+
+        seconds = prof->cycles[n] / oob_prof_hz;
+        fprintf( f, "%-14s %12llu %16llu %10.1f %6.1f%% %12.1f\n", oob_prof_stage_name[n],
+                 (unsigned long long)prof->calls[n], (unsigned long long)prof->cycles[n],
+                 (double)prof->cycles[n] / prof->calls[n], total ? 100.0 * prof->cycles[n] / total : 0.0,
+                 seconds > 0 ? prof->bytes[n] / seconds / 1e6 : 0.0 );
+    }
+#else
+    fprintf( f, "Profiling is not compiled in - rebuild with \"make PROFILE=1\".\n" );
+#endif
+}
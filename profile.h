@@ -0,0 +1,91 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+
+//--------------------------
+// Per-stage cycle counters
+//--------------------------
+//
+// built in only when compiled with -DOOB_PROFILE (make PROFILE=1) - otherwise the OOB_PROF_ macros expand to nothing,
+// oob_decoder has no counters and there is no cost at all
+// each oob_decoder accumulates its own counters (no sharing between threads), the counters of frame threads and
+// pipeline workers are added to the owning decoder like the FEC statistics
+// cycles come from the TSC on x86 (calibrated against CLOCK_MONOTONIC for the rates), CLOCK_MONOTONIC ns elsewhere
+
+
+#define OOB_PROF_SYNC           0           // sync search / tracking
+#define OOB_PROF_DEINTERLEAVE   1           // 1. de-interleaver (FEC path)
+#define OOB_PROF_FEC            2           // 2. Reed Solomon decoder
+#define OOB_PROF_DERANDOMIZE    3           // 3. + 4. derandomizer and parity drop (FEC path)
+#define OOB_PROF_DE_FRAME       4           // 1. + 3. + 4. fused frame kernel (no FEC)
+#define OOB_PROF_READ           5           // reading the input
+#define OOB_PROF_WRITE          6           // writing the TS output
+#define OOB_PROF_STAGES         7
+
+
+typedef struct oob_profile
+{
+    uint64_t cycles[OOB_PROF_STAGES];
+    uint64_t calls[OOB_PROF_STAGES];
+    uint64_t bytes[OOB_PROF_STAGES];
+} oob_profile;
+
+
+#ifdef OOB_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+static inline uint64_t oob_prof_now( void )
+{
+    return __rdtsc();
+}
+#else
+#include <time.h>
+
+static inline uint64_t oob_prof_now( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+
+static inline void oob_prof_add( oob_profile *prof, int stage, uint64_t cycles, uint64_t bytes )
+{
+    prof->cycles[stage] += cycles;
+    prof->calls[stage]++;
+    prof->bytes[stage] += bytes;
+}
+
+
+// OOB_PROF_START( t ) declares the timestamp t, OOB_PROF_LAP() charges the time since t to a stage and restarts t
+// OOB_PROF_RESET( t ) restarts t without charging the time since to any stage
+#define OOB_PROF_START( t )                     uint64_t t = oob_prof_now()
+#define OOB_PROF_LAP( prof, stage, t, nbytes )  do { uint64_t now_ = oob_prof_now(); oob_prof_add( (prof), (stage), now_ - (t), (nbytes) ); (t) = now_; } while( 0 )
+#define OOB_PROF_RESET( t )                     do { (t) = oob_prof_now(); } while( 0 )
+
+#else
+
+#define OOB_PROF_START( t )                     do {} while( 0 )
+#define OOB_PROF_LAP( prof, stage, t, nbytes )  do {} while( 0 )
+#define OOB_PROF_RESET( t )                     do {} while( 0 )
+
+#endif  // OOB_PROFILE
+
+
+// add the counters of src to dst and clear src
+void oob_prof_merge( oob_profile *dst, oob_profile *src );
+
+
+// print a per-stage breakdown - calls, cycles, cycles per call and bytes/sec while in the stage
+void oob_prof_report( FILE *f, const oob_profile *prof );
+
+
+#endif  // _PROFILE_H
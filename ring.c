@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "ring.h"
+
+
+// how many times to retry before going to sleep while waiting on a ring
+#define OOB_RING_SPIN   64
+
+
+// capacity is rounded up to a power of 2
+// return value: 0 if successful, negative value if unable to allocate the ring
+int oob_ring_init( oob_ring *ring, int capacity )
+{
+    uint32_t size = 1;
+
+
+    while( size < (uint32_t)capacity )
+        size <<= 1;
+
+    ring->slot = (void **)calloc( size, sizeof(void *) );
+    if( !ring->slot )
+        return -1;
+
+    ring->mask = size - 1;
+    atomic_init( &ring->head, 0 );
+    atomic_init( &ring->tail, 0 );
+    atomic_init( &ring->head_waiter, 0 );
+    atomic_init( &ring->tail_waiter, 0 );
+
+
+    return 0;
+}
+
+
+void oob_ring_free( oob_ring *ring )
+{
+    free( ring->slot );
+    ring->slot = NULL;
+}
+
+
+void oob_ring_wake( _Atomic uint32_t *word )
+{
+    syscall( SYS_futex, (uint32_t *)word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0 );
+}
+
+
+// sleep until *word is no longer seen - returns at once if it has moved on already (or on a spurious wake-up)
+static void oob_ring_sleep( _Atomic uint32_t *word, uint32_t seen )
+{
+    syscall( SYS_futex, (uint32_t *)word, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0 );
+}
+
+
+void oob_ring_push_wait( oob_ring *ring, void *item )
+{
+    uint32_t tail;
+    int spin = 0;
+
+
+    while( oob_ring_push( ring, item ) )
+    {
+        if( ++spin <= OOB_RING_SPIN )
+            continue;
+
+        // flag up, then look again - the consumer either sees the flag after its pop or we see its new tail
+        atomic_store_explicit( &ring->tail_waiter, 1, memory_order_relaxed );
+        atomic_thread_fence( memory_order_seq_cst );
+        tail = atomic_load_explicit( &ring->tail, memory_order_relaxed );
+        if( atomic_load_explicit( &ring->head, memory_order_relaxed ) - tail > ring->mask )
+            oob_ring_sleep( &ring->tail, tail );
+        atomic_store_explicit( &ring->tail_waiter, 0, memory_order_relaxed );
+    }
+}
+
+
+void *oob_ring_pop_wait( oob_ring *ring )
+{
+    void *item;
+    uint32_t head;
+    int spin = 0;
+
+
+    while( !(item = oob_ring_pop( ring )) )
+    {
+        if( ++spin <= OOB_RING_SPIN )
+            continue;
+
+        atomic_store_explicit( &ring->head_waiter, 1, memory_order_relaxed );
+        atomic_thread_fence( memory_order_seq_cst );
+        head = atomic_load_explicit( &ring->head, memory_order_relaxed );
+        if( head == atomic_load_explicit( &ring->tail, memory_order_relaxed ) )
+            oob_ring_sleep( &ring->head, head );
+        atomic_store_explicit( &ring->head_waiter, 0, memory_order_relaxed );
+    }
+
+
+    return item;
+}
@@ -0,0 +1,91 @@
+#ifndef _RING_H
+#define _RING_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+
+//-------------------------------------------------------
+// Bounded lock-free single-producer single-consumer ring
+//-------------------------------------------------------
+//
+// passes pointers from exactly one producer thread to exactly one consumer thread
+// head is only written by the producer, tail only by the consumer - no locks, no CAS
+// head and tail are kept on separate cache lines so producer and consumer don't bounce one line between cores
+// a thread that has to wait (oob_ring_push_wait() / oob_ring_pop_wait()) spins briefly, then sleeps on a futex on the
+// word the other side moves - it raises a waiter flag first, and the other side only makes the wake-up system call
+// when it sees the flag, so a ring nobody waits on costs a fence and a load per push / pop
+
+
+#define OOB_CACHE_LINE  64
+
+
+typedef struct oob_ring
+{
+    void **slot;
+    uint32_t mask;                                              // capacity-1, capacity is a power of 2
+
+    _Alignas(OOB_CACHE_LINE) _Atomic uint32_t head;             // next slot to be written by producer
+    _Atomic uint32_t head_waiter;                               // consumer is asleep on head (ring empty)
+    _Alignas(OOB_CACHE_LINE) _Atomic uint32_t tail;             // next slot to be read by consumer
+    _Atomic uint32_t tail_waiter;                               // producer is asleep on tail (ring full)
+} oob_ring;
+
+
+// capacity is rounded up to a power of 2
+// return value: 0 if successful, negative value if unable to allocate the ring
+int oob_ring_init( oob_ring *ring, int capacity );
+
+void oob_ring_free( oob_ring *ring );
+
+
+// wake the thread asleep on *word - used by push / pop when the waiter flag is up
+void oob_ring_wake( _Atomic uint32_t *word );
+
+
+// return value: 0 if successful, -1 if the ring is full
+static inline int oob_ring_push( oob_ring *ring, void *item )
+{
+    uint32_t head = atomic_load_explicit( &ring->head, memory_order_relaxed );
+
+    if( head - atomic_load_explicit( &ring->tail, memory_order_acquire ) > ring->mask )
+        return -1;
+
+    ring->slot[head & ring->mask] = item;
+    atomic_store_explicit( &ring->head, head+1, memory_order_release );
+
+    // the store to head before the look at the flag - pairs with the fence in oob_ring_pop_wait()
+    atomic_thread_fence( memory_order_seq_cst );
+    if( atomic_load_explicit( &ring->head_waiter, memory_order_relaxed ) )
+        oob_ring_wake( &ring->head );
+
+    return 0;
+}
+
+
+// return value: next item, or NULL if the ring is empty
+static inline void *oob_ring_pop( oob_ring *ring )
+{
+    uint32_t tail = atomic_load_explicit( &ring->tail, memory_order_relaxed );
+    void *item;
+
+    if( tail == atomic_load_explicit( &ring->head, memory_order_acquire ) )
+        return NULL;
+
+    item = ring->slot[tail & ring->mask];
+    atomic_store_explicit( &ring->tail, tail+1, memory_order_release );
+
+    atomic_thread_fence( memory_order_seq_cst );
+    if( atomic_load_explicit( &ring->tail_waiter, memory_order_relaxed ) )
+        oob_ring_wake( &ring->tail );
+
+    return item;
+}
+
+
+// blocking versions - spin briefly, then sleep until the ring has room / has an item
+void oob_ring_push_wait( oob_ring *ring, void *item );
+void *oob_ring_pop_wait( oob_ring *ring );
+
+
+#endif  // _RING_H
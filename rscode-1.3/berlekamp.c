@@ -38,47 +38,36 @@
 #include <stdio.h>
 #include "ecc.h"
 
-/* The Error Locator Polynomial, also known as Lambda or Sigma. Lambda[0] == 1 */
-static int Lambda[MAXDEG];
-
-/* The Error Evaluator Polynomial */
-static int Omega[MAXDEG];
+/* Lambda, Omega, the error locations and the erasure flags are kept
+   in the RS_STATE passed in by the caller. */
 
 /* local ANSI declarations */
 static int compute_discrepancy(int lambda[], int S[], int L, int n);
-static void init_gamma(int gamma[]);
-static void compute_modified_omega (void);
+static void init_gamma(RS_STATE *rs, int gamma[]);
+static void compute_modified_omega (RS_STATE *rs);
 static void mul_z_poly (int src[]);
 
-/* error locations found using Chien's search*/
-static int ErrorLocs[256];
-static int NErrors;
-
-/* erasure flags */
-static int ErasureLocs[256];
-static int NErasures;
-
 /* From  Cain, Clark, "Error-Correction Coding For Digital Communications", pp. 216. */
 void
-Modified_Berlekamp_Massey (void)
+Modified_Berlekamp_Massey (RS_STATE *rs)
 {	
   int n, L, L2, k, d, i;
   int psi[MAXDEG], psi2[MAXDEG], D[MAXDEG];
   int gamma[MAXDEG];
 	
   /* initialize Gamma, the erasure locator polynomial */
-  init_gamma(gamma);
+  init_gamma(rs, gamma);
 
   /* initialize to z */
   copy_poly(D, gamma);
   mul_z_poly(D);
 	
   copy_poly(psi, gamma);	
-  k = -1; L = NErasures;
+  k = -1; L = rs->NErasures;
 	
-  for (n = NErasures; n < NPAR; n++) {
+  for (n = rs->NErasures; n < NPAR; n++) {
 	
-    d = compute_discrepancy(psi, synBytes, L, n);
+    d = compute_discrepancy(psi, rs->synBytes, L, n);
 		
     if (d != 0) {
 		
@@ -101,8 +90,8 @@ Modified_Berlekamp_Massey (void)
     mul_z_poly(D);
   }
 	
-  for(i = 0; i < MAXDEG; i++) Lambda[i] = psi[i];
-  compute_modified_omega();
+  for(i = 0; i < MAXDEG; i++) rs->Lambda[i] = psi[i];
+  compute_modified_omega(rs);
 
 	
 }
@@ -112,14 +101,14 @@ Modified_Berlekamp_Massey (void)
    Psi*S mod z^4
   */
 void
-compute_modified_omega ()
+compute_modified_omega (RS_STATE *rs)
 {
   int i;
   int product[MAXDEG*2];
 	
-  mult_polys(product, Lambda, synBytes);	
-  zero_poly(Omega);
-  for(i = 0; i < NPAR; i++) Omega[i] = product[i];
+  mult_polys(product, rs->Lambda, rs->synBytes);	
+  zero_poly(rs->Omega);
+  for(i = 0; i < NPAR; i++) rs->Omega[i] = product[i];
 
 }
 
@@ -150,7 +139,7 @@ mult_polys (int dst[], int p1[], int p2[])
 	
 /* gamma = product (1-z*a^Ij) for erasure locs Ij */
 void
-init_gamma (int gamma[])
+init_gamma (RS_STATE *rs, int gamma[])
 {
   int e, tmp[MAXDEG];
 	
@@ -158,9 +147,9 @@ init_gamma (int gamma[])
   zero_poly(tmp);
   gamma[0] = 1;
 	
-  for (e = 0; e < NErasures; e++) {
+  for (e = 0; e < rs->NErasures; e++) {
     copy_poly(tmp, gamma);
-    scale_poly(gexp[ErasureLocs[e]], tmp);
+    scale_poly(gexp[rs->ErasureLocs[e]], tmp);
     mul_z_poly(tmp);
     add_polys(gamma, tmp);
   }
@@ -230,24 +219,32 @@ static void mul_z_poly (int src[])
  * Lambda[j] by evaluating Lambda at successive values of alpha. 
  * 
  * This can be tested with the decoder's equations case.
+ *
+ * Chien search: term k is Lambda[k] * alpha^(k*r), so going from r to
+ * r+1 multiplies it by the fixed constant alpha^k - one gexp_row[k]
+ * lookup instead of a gmult() by gexp[(k*r)%255].
  */
 
 
 void 
-Find_Roots (void)
+Find_Roots (RS_STATE *rs)
 {
   int sum, r, k;	
-  NErrors = 0;
+  int term[NPAR+1];
+  rs->NErrors = 0;
+
+  for (k = 0; k < NPAR+1; k++) term[k] = rs->Lambda[k];
   
   for (r = 1; r < 256; r++) {
     sum = 0;
     /* evaluate lambda at r */
     for (k = 0; k < NPAR+1; k++) {
-      sum ^= gmult(gexp[(k*r)%255], Lambda[k]);
+      term[k] = gexp_row[k][term[k]];
+      sum ^= term[k];
     }
     if (sum == 0) 
       { 
-	ErrorLocs[NErrors] = (255-r); NErrors++; 
+	rs->ErrorLocs[rs->NErrors] = (255-r); rs->NErrors++; 
 	if (DEBUG) fprintf(stderr, "Root found at r = %d, (255-r) = %d\n", r, (255-r));
       }
   }
@@ -267,7 +264,8 @@ Find_Roots (void)
  */
 
 int
-correct_errors_erasures (unsigned char codeword[], 
+correct_errors_erasures (RS_STATE *rs,
+			 unsigned char codeword[], 
 			 int csize,
 			 int nerasures,
 			 int erasures[])
@@ -277,36 +275,36 @@ correct_errors_erasures (unsigned char codeword[],
   /* If you want to take advantage of erasure correction, be sure to
      set NErasures and ErasureLocs[] with the locations of erasures. 
      */
-  NErasures = nerasures;
-  for (i = 0; i < NErasures; i++) ErasureLocs[i] = erasures[i];
+  rs->NErasures = nerasures;
+  for (i = 0; i < rs->NErasures; i++) rs->ErasureLocs[i] = erasures[i];
 
-  Modified_Berlekamp_Massey();
-  Find_Roots();
+  Modified_Berlekamp_Massey(rs);
+  Find_Roots(rs);
   
 
-  if ((NErrors <= NPAR) && NErrors > 0) { 
+  if ((rs->NErrors <= NPAR) && rs->NErrors > 0) { 
 
     /* first check for illegal error locs */
-    for (r = 0; r < NErrors; r++) {
-      if (ErrorLocs[r] >= csize) {
+    for (r = 0; r < rs->NErrors; r++) {
+      if (rs->ErrorLocs[r] >= csize) {
 	if (DEBUG) fprintf(stderr, "Error loc i=%d outside of codeword length %d\n", i, csize);
 	return(0);
       }
     }
 
-    for (r = 0; r < NErrors; r++) {
+    for (r = 0; r < rs->NErrors; r++) {
       int num, denom;
-      i = ErrorLocs[r];
+      i = rs->ErrorLocs[r];
       /* evaluate Omega at alpha^(-i) */
 
       num = 0;
       for (j = 0; j < MAXDEG; j++) 
-	num ^= gmult(Omega[j], gexp[((255-i)*j)%255]);
+	num ^= gmult(rs->Omega[j], gexp[((255-i)*j)%255]);
       
       /* evaluate Lambda' (derivative) at alpha^(-i) ; all odd powers disappear */
       denom = 0;
       for (j = 1; j < MAXDEG; j += 2) {
-	denom ^= gmult(Lambda[j], gexp[((255-i)*(j-1)) % 255]);
+	denom ^= gmult(rs->Lambda[j], gexp[((255-i)*(j-1)) % 255]);
       }
       
       err = gmult(num, ginv(denom));
@@ -317,7 +315,7 @@ correct_errors_erasures (unsigned char codeword[],
     return(1);
   }
   else {
-    if (DEBUG && NErrors) fprintf(stderr, "Uncorrectable codeword\n");
+    if (DEBUG && rs->NErrors) fprintf(stderr, "Uncorrectable codeword\n");
     return(0);
   }
 }
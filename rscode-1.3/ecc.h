@@ -61,35 +61,110 @@ typedef unsigned short BIT16;
 #define MAXDEG (NPAR*2)
 
 /*************************************/
-/* Encoder parity bytes */
-extern int pBytes[MAXDEG];
+/* Per-decoder state.  Everything that changes while encoding or
+   decoding a codeword lives here, so that several codewords can be
+   processed at once (one RS_STATE each).  The galois field tables and
+   the generator polynomial are const data generated at build time
+   (gentables writes gftables.c), shared by everything. */
+typedef struct rs_state {
+  /* Encoder parity bytes */
+  int pBytes[MAXDEG];
 
-/* Decoder syndrome bytes */
-extern int synBytes[MAXDEG];
+  /* Decoder syndrome bytes */
+  int synBytes[MAXDEG];
+
+  /* The Error Locator Polynomial, also known as Lambda or Sigma. Lambda[0] == 1 */
+  int Lambda[MAXDEG];
+
+  /* The Error Evaluator Polynomial */
+  int Omega[MAXDEG];
+
+  /* error locations found using Chien's search*/
+  int ErrorLocs[256];
+  int NErrors;
+
+  /* erasure flags */
+  int ErasureLocs[256];
+  int NErasures;
+} RS_STATE;
+
+/* generator polynomial */
+extern const int genPoly[MAXDEG*2];
 
 /* print debugging info */
 extern int DEBUG;
 
 /* Reed Solomon encode/decode routines */
 void initialize_ecc (void);
-int check_syndrome (void);
-void decode_data (unsigned char data[], int nbytes);
-void encode_data (unsigned char msg[], int nbytes, unsigned char dst[]);
+int check_syndrome (RS_STATE *rs);
+void decode_data (RS_STATE *rs, unsigned char data[], int nbytes);
+void decode_data_batch (unsigned char data[], int nbytes, int stride, int nblocks, unsigned char syn[]);
+void encode_data (RS_STATE *rs, unsigned char msg[], int nbytes, unsigned char dst[]);
+
+/* vectorized syndrome computation, used by decode_data() for codewords
+   of up to SYN_BLOCKS*16 bytes when the CPU supports it */
+#define SYN_BLOCKS 16
+extern void (*syndrome_kernel)(unsigned char data[], int nbytes, int syn[]);
+/* many codewords at once, one per vector lane, for decode_data_batch():
+   computes codewords first.. in whole groups of its lane count and
+   returns the index of the first codeword left over (first itself if
+   nbytes is not a multiple of 16) */
+extern int (*syndrome_batch_kernel)(unsigned char data[], int nbytes, int stride, int first, int nblocks, unsigned char syn[]);
+void init_syndrome_tables (void);
+
+/* kernel tiers for select_syndrome_kernels() */
+#define SYN_TIER_NONE   0       /* Horner's rule only */
+#define SYN_TIER_SSSE3  1
+#define SYN_TIER_AVX2   2
+#define SYN_TIER_GFNI   3       /* AVX2 + GFNI */
+#define SYN_TIER_AVX512 4       /* AVX-512BW, with GFNI if the CPU has it */
+#define SYN_TIER_MAX    SYN_TIER_AVX512
+int select_syndrome_kernels (int max_tier);
 
 /* CRC-CCITT checksum generator */
 BIT16 crc_ccitt(unsigned char *msg, int len);
 
-/* galois arithmetic tables */
-extern int gexp[];
-extern int glog[];
-
-void init_galois_tables (void);
-int ginv(int elt); 
-int gmult(int a, int b);
+/* galois arithmetic tables - one byte per entry, so gexp[] and glog[]
+   take 768 bytes of cache.  gexp[] holds two periods, so that
+   gexp[glog[a] + glog[b]] needs no reduction mod 255.
+   GF(256) is built on p(X) = X^8 + X^4 + X^3 + X^2 + 1; the tables
+   are generated by gentables.c into gftables.c. */
+extern const unsigned char gexp[512];
+extern const unsigned char glog[256];
+
+/* products by the fixed powers of alpha: gexp_row[k][x] = alpha^k * x,
+   for the syndrome (alpha^1 .. alpha^NPAR) and Chien search
+   (alpha^0 .. alpha^NPAR) constants */
+#define GF_ROWS (MAXDEG+1)
+extern const unsigned char gexp_row[GF_ROWS][256];
+
+/* full 64 KB multiplication table gmul_table[a][b] = a * b - only
+   compiled in, and used by gmult(), with -DGF_MUL_TABLE (make GFTABLE=1) */
+#ifdef GF_MUL_TABLE
+extern const unsigned char gmul_table[256][256];
+#endif
+
+/* multiplication, inlined and branch free: glog[0] is 0, so the lookup
+   is always in range, and the product is masked to 0 when a factor is 0 */
+static inline int
+gmult (int a, int b)
+{
+#ifdef GF_MUL_TABLE
+  return gmul_table[a][b];
+#else
+  return gexp[glog[a] + glog[b]] & -((a != 0) & (b != 0));
+#endif
+}
+
+static inline int
+ginv (int elt)
+{
+  return gexp[255 - glog[elt]];
+}
 
 
 /* Error location routines */
-int correct_errors_erasures (unsigned char codeword[], int csize,int nerasures, int erasures[]);
+int correct_errors_erasures (RS_STATE *rs, unsigned char codeword[], int csize,int nerasures, int erasures[]);
 
 /* polynomial arithmetic */
 void add_polys(int dst[], int src[]) ;
@@ -79,6 +79,7 @@ main (int argc, char *argv[])
  
   int erasures[16];
   int nerasures = 0;
+  RS_STATE rs;
 
   /* Initialization the ECC library */
  
@@ -87,7 +88,7 @@ main (int argc, char *argv[])
   /* ************** */
  
   /* Encode data into codeword, adding NPAR parity bytes */
-  encode_data(msg, sizeof(msg), codeword);
+  encode_data(&rs, msg, sizeof(msg), codeword);
  
   printf("Encoded data is: \"%s\"\n", codeword);
  
@@ -111,11 +112,12 @@ main (int argc, char *argv[])
 
  
   /* Now decode -- encoded codeword size must be passed */
-  decode_data(codeword, ML);
+  decode_data(&rs, codeword, ML);
 
   /* check if syndrome is all zeros */
-  if (check_syndrome () != 0) {
-    correct_errors_erasures (codeword, 
+  if (check_syndrome (&rs) != 0) {
+    correct_errors_erasures (&rs,
+                             codeword, 
 			     ML,
 			     nerasures, 
 			     erasures);
@@ -29,29 +29,17 @@
 #include <ctype.h>
 #include "ecc.h"
 
-/* Encoder parity bytes */
-int pBytes[MAXDEG];
-
-/* Decoder syndrome bytes */
-int synBytes[MAXDEG];
-
-/* generator polynomial */
-int genPoly[MAXDEG*2];
-
 int DEBUG = FALSE;
 
-static void
-compute_genpoly (int nbytes, int genpoly[]);
-
-/* Initialize lookup tables, polynomials, etc. */
+/* Initialize lookup tables, polynomials, etc.
+   The galois field tables and the generator polynomial are generated at
+   build time (gftables.c) - only the vector syndrome kernels, which
+   depend on the CPU, are set up here. */
 void
 initialize_ecc ()
 {
-  /* Initialize the galois field arithmetic tables */
-    init_galois_tables();
-
-    /* Compute the encoder generator polynomial */
-    compute_genpoly(NPAR, genPoly);
+    /* Build the per-position tables for the vector syndrome kernels */
+    init_syndrome_tables();
 }
 
 void
@@ -63,36 +51,36 @@ zero_fill_from (unsigned char buf[], int from, int to)
 
 /* debugging routines */
 void
-print_parity (void)
+print_parity (RS_STATE *rs)
 { 
   int i;
   printf("Parity Bytes: ");
   for (i = 0; i < NPAR; i++) 
-    printf("[%d]:%x, ",i,pBytes[i]);
+    printf("[%d]:%x, ",i,rs->pBytes[i]);
   printf("\n");
 }
 
 
 void
-print_syndrome (void)
+print_syndrome (RS_STATE *rs)
 { 
   int i;
   printf("Syndrome Bytes: ");
   for (i = 0; i < NPAR; i++) 
-    printf("[%d]:%x, ",i,synBytes[i]);
+    printf("[%d]:%x, ",i,rs->synBytes[i]);
   printf("\n");
 }
 
 /* Append the parity bytes onto the end of the message */
 void
-build_codeword (unsigned char msg[], int nbytes, unsigned char dst[])
+build_codeword (RS_STATE *rs, unsigned char msg[], int nbytes, unsigned char dst[])
 {
   int i;
 	
   for (i = 0; i < nbytes; i++) dst[i] = msg[i];
 	
   for (i = 0; i < NPAR; i++) {
-    dst[i+nbytes] = pBytes[NPAR-1-i];
+    dst[i+nbytes] = rs->pBytes[NPAR-1-i];
   }
 }
 	
@@ -100,30 +88,64 @@ build_codeword (unsigned char msg[], int nbytes, unsigned char dst[])
  * Reed Solomon Decoder 
  *
  * Computes the syndrome of a codeword. Puts the results
- * into the synBytes[] array.
+ * into the rs->synBytes[] array.
  */
  
 void
-decode_data(unsigned char data[], int nbytes)
+decode_data(RS_STATE *rs, unsigned char data[], int nbytes)
 {
   int i, j, sum;
+
+  if (syndrome_kernel && nbytes <= SYN_BLOCKS*16) {
+    syndrome_kernel(data, nbytes, rs->synBytes);
+    return;
+  }
+
   for (j = 0; j < NPAR;  j++) {
+    const unsigned char *row = gexp_row[j+1];
+
     sum	= 0;
     for (i = 0; i < nbytes; i++) {
-      sum = data[i] ^ gmult(gexp[j+1], sum);
+      sum = data[i] ^ row[sum];
     }
-    synBytes[j]  = sum;
+    rs->synBytes[j]  = sum;
   }
 }
 
 
+/* Syndromes of nblocks codewords of nbytes each, stride bytes apart, in
+   structure-of-arrays order: syn[j*nblocks + k] is syndrome j of
+   codeword k.  The vector kernel takes the codewords a group at a time,
+   one per lane; whatever it leaves goes through Horner's rule here. */
+void
+decode_data_batch (unsigned char data[], int nbytes, int stride, int nblocks, unsigned char syn[])
+{
+  int i, j, k, sum;
+  int done = 0;
+
+  if (syndrome_batch_kernel)
+    done = syndrome_batch_kernel(data, nbytes, stride, 0, nblocks, syn);
+
+  for (k = done; k < nblocks; k++) {
+    for (j = 0; j < NPAR;  j++) {
+      const unsigned char *row = gexp_row[j+1];
+
+      sum = 0;
+      for (i = 0; i < nbytes; i++) {
+        sum = data[k*stride + i] ^ row[sum];
+      }
+      syn[j*nblocks + k] = sum;
+    }
+  }
+}
+
 /* Check if the syndrome is zero */
 int
-check_syndrome (void)
+check_syndrome (RS_STATE *rs)
 {
  int i, nz = 0;
  for (i =0 ; i < NPAR; i++) {
-  if (synBytes[i] != 0) {
+  if (rs->synBytes[i] != 0) {
       nz = 1;
       break;
   }
@@ -133,54 +155,27 @@ check_syndrome (void)
 
 
 void
-debug_check_syndrome (void)
+debug_check_syndrome (RS_STATE *rs)
 {	
   int i;
 	
   for (i = 0; i < 3; i++) {
     printf(" inv log S[%d]/S[%d] = %d\n", i, i+1, 
-	   glog[gmult(synBytes[i], ginv(synBytes[i+1]))]);
+	   glog[gmult(rs->synBytes[i], ginv(rs->synBytes[i+1]))]);
   }
 }
 
 
-/* Create a generator polynomial for an n byte RS code. 
- * The coefficients are returned in the genPoly arg.
- * Make sure that the genPoly array which is passed in is 
- * at least n+1 bytes long.
- */
-
-static void
-compute_genpoly (int nbytes, int genpoly[])
-{
-  int i;
-  int tp[256], tp1[256];
-	
-  /* multiply (x + a^n) for n = 1 to nbytes */
-
-  zero_poly(tp1);
-  tp1[0] = 1;
-
-  for (i = 1; i <= nbytes; i++) {
-    zero_poly(tp);
-    tp[0] = gexp[i];		// set up x+a^n
-    tp[1] = 1;
-	  
-    mult_polys(genpoly, tp, tp1);
-    copy_poly(tp1, genpoly);
-  }
-}
-
 /* Simulate a LFSR with generator polynomial for n byte RS code. 
  * Pass in a pointer to the data array, and amount of data. 
  *
- * The parity bytes are deposited into pBytes[], and the whole message
+ * The parity bytes are deposited into rs->pBytes[], and the whole message
  * and parity are copied to dest to make a codeword.
  * 
  */
 
 void
-encode_data (unsigned char msg[], int nbytes, unsigned char dst[])
+encode_data (RS_STATE *rs, unsigned char msg[], int nbytes, unsigned char dst[])
 {
   int i, LFSR[NPAR+1],dbyte, j;
 	
@@ -195,8 +190,8 @@ encode_data (unsigned char msg[], int nbytes, unsigned char dst[])
   }
 
   for (i = 0; i < NPAR; i++) 
-    pBytes[i] = LFSR[i];
+    rs->pBytes[i] = LFSR[i];
 	
-  build_codeword(msg, nbytes, dst);
+  build_codeword(rs, msg, nbytes, dst);
 }
 
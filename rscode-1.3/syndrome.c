@@ -0,0 +1,527 @@
+/*****************************
+ * Vectorized syndrome computation for decode_data()
+ *
+ * The syndrome S[j] of an n byte codeword is
+ *
+ *   S[j] = sum over k of data[n-1-k] * b^k      with b = alpha^(j+1)
+ *
+ * decode_data() evaluates this with Horner's rule, one byte at a
+ * time, every step depending on the previous one.  Here the codeword
+ * is split into 16 byte blocks (zero padded at the front, leading
+ * zeros do not change the syndrome) and each block is multiplied by
+ * the constant b^(16e) for its position e, counted in blocks from the
+ * end of the codeword.  Those products are independent, so the work
+ * is a parallel dot product that is XOR-accumulated into one 16 lane
+ * vector A.  The lanes are then folded in halves,
+ *
+ *   A'[u] = b^8 * A[u] ^ A[u+8],  then b^4, b^2 and b^1,
+ *
+ * leaving S[j] in lane 0.  Every multiply is by a constant that is the
+ * same in all lanes, so it can be done with two PSHUFB lookups on the
+ * low and high nibbles, or with one GF2P8AFFINEQB 8x8 bit matrix
+ * (GF2P8MULB cannot be used, it is hardwired to the AES polynomial).
+ *
+ * The AVX2 variants compute two syndromes at once, one per 128 bit
+ * lane, since VPSHUFB looks up each 128 bit lane in its own table.
+ *
+ * The batch kernels (decode_data_batch()) turn this around for many
+ * codewords of the same length: 16 codewords (32 with AVX2 and 64 with
+ * AVX-512, 16 per 128 bit lane) are transposed 16 bytes at a time, so that each lane
+ * holds a different codeword and vector i holds byte i of all of
+ * them.  Horner's rule then runs on whole vectors,
+ *
+ *   A[j] = b * A[j] ^ byte i,   b = alpha^(j+1)
+ *
+ * a multiply by a constant that is the same in every lane, and no
+ * fold at the end - lane k of A[j] is syndrome j of codeword k.
+ *
+ ******************************/
+
+#include <string.h>
+#include "ecc.h"
+
+/* syndromes are computed in pairs by the AVX2 kernels */
+#define NPAR_EVEN (NPAR + (NPAR & 1))
+
+/* constants 0..SYN_BLOCKS-1 are b^(16e), SYN_BLOCKS..SYN_BLOCKS+3 the fold constants b^8, b^4, b^2, b^1 */
+#define SYN_NCONST (SYN_BLOCKS + 4)
+
+void (*syndrome_kernel)(unsigned char data[], int nbytes, int syn[]) = 0;
+int (*syndrome_batch_kernel)(unsigned char data[], int nbytes, int stride, int first, int nblocks, unsigned char syn[]) = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+/* nibble product tables: synMulLo[c][j][x] = K*x, synMulHi[c][j][x] = K*(x<<4), K = constant c of syndrome j */
+static unsigned char synMulLo[SYN_NCONST][NPAR_EVEN][16] __attribute__((aligned(32)));
+static unsigned char synMulHi[SYN_NCONST][NPAR_EVEN][16] __attribute__((aligned(32)));
+
+/* GF2P8AFFINEQB matrices for the same constants, each repeated for both qwords of a 128 bit lane */
+static unsigned long long synAffine[SYN_NCONST][NPAR_EVEN][2] __attribute__((aligned(32)));
+
+
+/* bit matrix of multiplication by k, in the row order GF2P8AFFINEQB expects (row i in byte 7-i) */
+static unsigned long long
+affine_matrix (int k)
+{
+  unsigned long long m = 0;
+  int i, j;
+
+  for (i = 0; i < 8; i++) {
+    int row = 0;
+    for (j = 0; j < 8; j++)
+      if (gmult(k, 1 << j) & (1 << i)) row |= 1 << j;
+    m |= (unsigned long long) row << (8 * (7 - i));
+  }
+  return m;
+}
+
+
+/* load block q of the front-padded codeword */
+#define SYN_PAD(nbytes)   (((nbytes) + 15) / 16 * 16 - (nbytes))
+
+static inline void
+load_first_block (unsigned char blk[16], unsigned char data[], int nbytes)
+{
+  int pad = SYN_PAD(nbytes);
+
+  memset(blk, 0, pad);
+  memcpy(blk + pad, data, 16 - pad);
+}
+
+
+__attribute__((target("ssse3")))
+static inline __m128i
+mul_ssse3 (__m128i v, int c, int j)
+{
+  const __m128i mask = _mm_set1_epi8(0x0f);
+  __m128i lo = _mm_and_si128(v, mask);
+  __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+
+  return _mm_xor_si128(_mm_shuffle_epi8(_mm_load_si128((__m128i *) synMulLo[c][j]), lo),
+                       _mm_shuffle_epi8(_mm_load_si128((__m128i *) synMulHi[c][j]), hi));
+}
+
+__attribute__((target("ssse3")))
+static void
+syndromes_ssse3 (unsigned char data[], int nbytes, int syn[])
+{
+  unsigned char first[16];
+  int nblocks = (nbytes + 15) / 16;
+  int pad = SYN_PAD(nbytes);
+  int j, q;
+
+  load_first_block(first, data, nbytes);
+
+  for (j = 0; j < NPAR; j++) {
+    __m128i acc = mul_ssse3(_mm_loadu_si128((__m128i *) first), nblocks-1, j);
+
+    for (q = 1; q < nblocks; q++)
+      acc = _mm_xor_si128(acc, mul_ssse3(_mm_loadu_si128((__m128i *) (data + 16*q - pad)), nblocks-1-q, j));
+
+    acc = _mm_xor_si128(mul_ssse3(acc, SYN_BLOCKS+0, j), _mm_srli_si128(acc, 8));
+    acc = _mm_xor_si128(mul_ssse3(acc, SYN_BLOCKS+1, j), _mm_srli_si128(acc, 4));
+    acc = _mm_xor_si128(mul_ssse3(acc, SYN_BLOCKS+2, j), _mm_srli_si128(acc, 2));
+    acc = _mm_xor_si128(mul_ssse3(acc, SYN_BLOCKS+3, j), _mm_srli_si128(acc, 1));
+
+    syn[j] = _mm_cvtsi128_si32(acc) & 0xff;
+  }
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256i
+mul_avx2 (__m256i v, int c, int j)
+{
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  __m256i lo = _mm256_and_si256(v, mask);
+  __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+
+  return _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_load_si256((__m256i *) synMulLo[c][j]), lo),
+                          _mm256_shuffle_epi8(_mm256_load_si256((__m256i *) synMulHi[c][j]), hi));
+}
+
+__attribute__((target("avx2")))
+static void
+syndromes_avx2 (unsigned char data[], int nbytes, int syn[])
+{
+  unsigned char first[16];
+  int nblocks = (nbytes + 15) / 16;
+  int pad = SYN_PAD(nbytes);
+  int j, q;
+
+  load_first_block(first, data, nbytes);
+
+  for (j = 0; j < NPAR; j += 2) {
+    __m256i acc = mul_avx2(_mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *) first)), nblocks-1, j);
+
+    for (q = 1; q < nblocks; q++)
+      acc = _mm256_xor_si256(acc, mul_avx2(_mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *) (data + 16*q - pad))), nblocks-1-q, j));
+
+    acc = _mm256_xor_si256(mul_avx2(acc, SYN_BLOCKS+0, j), _mm256_srli_si256(acc, 8));
+    acc = _mm256_xor_si256(mul_avx2(acc, SYN_BLOCKS+1, j), _mm256_srli_si256(acc, 4));
+    acc = _mm256_xor_si256(mul_avx2(acc, SYN_BLOCKS+2, j), _mm256_srli_si256(acc, 2));
+    acc = _mm256_xor_si256(mul_avx2(acc, SYN_BLOCKS+3, j), _mm256_srli_si256(acc, 1));
+
+    syn[j] = _mm256_extract_epi8(acc, 0) & 0xff;
+    if (j+1 < NPAR) syn[j+1] = _mm256_extract_epi8(acc, 16) & 0xff;
+  }
+}
+
+
+__attribute__((target("gfni,avx2")))
+static inline __m256i
+mul_gfni (__m256i v, int c, int j)
+{
+  return _mm256_gf2p8affine_epi64_epi8(v, _mm256_load_si256((__m256i *) synAffine[c][j]), 0);
+}
+
+__attribute__((target("gfni,avx2")))
+static void
+syndromes_gfni (unsigned char data[], int nbytes, int syn[])
+{
+  unsigned char first[16];
+  int nblocks = (nbytes + 15) / 16;
+  int pad = SYN_PAD(nbytes);
+  int j, q;
+
+  load_first_block(first, data, nbytes);
+
+  for (j = 0; j < NPAR; j += 2) {
+    __m256i acc = mul_gfni(_mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *) first)), nblocks-1, j);
+
+    for (q = 1; q < nblocks; q++)
+      acc = _mm256_xor_si256(acc, mul_gfni(_mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *) (data + 16*q - pad))), nblocks-1-q, j));
+
+    acc = _mm256_xor_si256(mul_gfni(acc, SYN_BLOCKS+0, j), _mm256_srli_si256(acc, 8));
+    acc = _mm256_xor_si256(mul_gfni(acc, SYN_BLOCKS+1, j), _mm256_srli_si256(acc, 4));
+    acc = _mm256_xor_si256(mul_gfni(acc, SYN_BLOCKS+2, j), _mm256_srli_si256(acc, 2));
+    acc = _mm256_xor_si256(mul_gfni(acc, SYN_BLOCKS+3, j), _mm256_srli_si256(acc, 1));
+
+    syn[j] = _mm256_extract_epi8(acc, 0) & 0xff;
+    if (j+1 < NPAR) syn[j+1] = _mm256_extract_epi8(acc, 16) & 0xff;
+  }
+}
+
+
+/* 16x16 byte transpose: r[q] is byte q..q+15 of codeword q on the way in,
+   r[i] is byte i of the 16 codewords on the way out.  Four rounds of
+   unpacks, each doubling the run of bytes that belong together. */
+#define SYN_TRANSPOSE(T, r, unpacklo8, unpackhi8, unpacklo16, unpackhi16, unpacklo32, unpackhi32, unpacklo64, unpackhi64) \
+  do {                                                                  \
+    T a_[16], b_[16];                                                   \
+    int i_, q_;                                                         \
+    for (i_ = 0; i_ < 8; i_++) {         /* pairs of rows */            \
+      a_[2*i_]   = unpacklo8(r[2*i_], r[2*i_+1]);                       \
+      a_[2*i_+1] = unpackhi8(r[2*i_], r[2*i_+1]);                       \
+    }                                                                   \
+    for (i_ = 0; i_ < 4; i_++) {         /* rows 4i..4i+3 */            \
+      b_[4*i_]   = unpacklo16(a_[4*i_],   a_[4*i_+2]);                  \
+      b_[4*i_+1] = unpackhi16(a_[4*i_],   a_[4*i_+2]);                  \
+      b_[4*i_+2] = unpacklo16(a_[4*i_+1], a_[4*i_+3]);                  \
+      b_[4*i_+3] = unpackhi16(a_[4*i_+1], a_[4*i_+3]);                  \
+    }                                                                   \
+    for (i_ = 0; i_ < 2; i_++)           /* rows 8i..8i+7 */            \
+      for (q_ = 0; q_ < 4; q_++) {                                      \
+        a_[8*i_+2*q_]   = unpacklo32(b_[8*i_+q_], b_[8*i_+4+q_]);       \
+        a_[8*i_+2*q_+1] = unpackhi32(b_[8*i_+q_], b_[8*i_+4+q_]);       \
+      }                                                                 \
+    for (i_ = 0; i_ < 8; i_++) {         /* all 16 rows */              \
+      r[2*i_]   = unpacklo64(a_[i_], a_[8+i_]);                         \
+      r[2*i_+1] = unpackhi64(a_[i_], a_[8+i_]);                         \
+    }                                                                   \
+  } while (0)
+
+
+__attribute__((target("ssse3")))
+static int
+syndromes_batch_ssse3 (unsigned char data[], int nbytes, int stride, int first, int nblocks, unsigned char syn[])
+{
+  const __m128i mask = _mm_set1_epi8(0x0f);
+  __m128i lo[NPAR], hi[NPAR], acc[NPAR], r[16];
+  int k, i, q, j;
+
+  if (nbytes % 16)
+    return first;
+
+  for (j = 0; j < NPAR; j++) {
+    lo[j] = _mm_load_si128((__m128i *) synMulLo[SYN_BLOCKS+3][j]);
+    hi[j] = _mm_load_si128((__m128i *) synMulHi[SYN_BLOCKS+3][j]);
+  }
+
+  for (k = first; k + 16 <= nblocks; k += 16) {
+    for (j = 0; j < NPAR; j++)
+      acc[j] = _mm_setzero_si128();
+
+    for (i = 0; i < nbytes; i += 16) {
+      for (q = 0; q < 16; q++)
+        r[q] = _mm_loadu_si128((__m128i *) (data + (k+q)*stride + i));
+      SYN_TRANSPOSE(__m128i, r, _mm_unpacklo_epi8, _mm_unpackhi_epi8, _mm_unpacklo_epi16, _mm_unpackhi_epi16,
+                    _mm_unpacklo_epi32, _mm_unpackhi_epi32, _mm_unpacklo_epi64, _mm_unpackhi_epi64);
+
+      for (q = 0; q < 16; q++)
+        for (j = 0; j < NPAR; j++)
+          acc[j] = _mm_xor_si128(r[q], _mm_xor_si128(_mm_shuffle_epi8(lo[j], _mm_and_si128(acc[j], mask)),
+                                                     _mm_shuffle_epi8(hi[j], _mm_and_si128(_mm_srli_epi16(acc[j], 4), mask))));
+    }
+
+    for (j = 0; j < NPAR; j++)
+      _mm_storeu_si128((__m128i *) (syn + j*nblocks + k), acc[j]);
+  }
+  return k;
+}
+
+
+/* load 16 bytes of codeword q into the low lane and of codeword q+16 into the high lane */
+#define SYN_LOAD2(p, stride) \
+  _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((__m128i *) (p))), _mm_loadu_si128((__m128i *) ((p) + 16*(stride))), 1)
+
+/* the wider kernels hand the codewords that don't fill one of their
+   groups on to the next narrower kernel */
+__attribute__((target("avx2")))
+static int
+syndromes_batch_avx2 (unsigned char data[], int nbytes, int stride, int first, int nblocks, unsigned char syn[])
+{
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  __m256i lo[NPAR], hi[NPAR], acc[NPAR], r[16];
+  int k, i, q, j;
+
+  if (nbytes % 16)
+    return first;
+
+  for (j = 0; j < NPAR; j++) {
+    lo[j] = _mm256_broadcastsi128_si256(_mm_load_si128((__m128i *) synMulLo[SYN_BLOCKS+3][j]));
+    hi[j] = _mm256_broadcastsi128_si256(_mm_load_si128((__m128i *) synMulHi[SYN_BLOCKS+3][j]));
+  }
+
+  for (k = first; k + 32 <= nblocks; k += 32) {
+    for (j = 0; j < NPAR; j++)
+      acc[j] = _mm256_setzero_si256();
+
+    for (i = 0; i < nbytes; i += 16) {
+      for (q = 0; q < 16; q++)
+        r[q] = SYN_LOAD2(data + (k+q)*stride + i, stride);
+      SYN_TRANSPOSE(__m256i, r, _mm256_unpacklo_epi8, _mm256_unpackhi_epi8, _mm256_unpacklo_epi16, _mm256_unpackhi_epi16,
+                    _mm256_unpacklo_epi32, _mm256_unpackhi_epi32, _mm256_unpacklo_epi64, _mm256_unpackhi_epi64);
+
+      for (q = 0; q < 16; q++)
+        for (j = 0; j < NPAR; j++)
+          acc[j] = _mm256_xor_si256(r[q], _mm256_xor_si256(_mm256_shuffle_epi8(lo[j], _mm256_and_si256(acc[j], mask)),
+                                                           _mm256_shuffle_epi8(hi[j], _mm256_and_si256(_mm256_srli_epi16(acc[j], 4), mask))));
+    }
+
+    for (j = 0; j < NPAR; j++)
+      _mm256_storeu_si256((__m256i *) (syn + j*nblocks + k), acc[j]);
+  }
+  return syndromes_batch_ssse3(data, nbytes, stride, k, nblocks, syn);
+}
+
+
+__attribute__((target("gfni,avx2")))
+static int
+syndromes_batch_gfni (unsigned char data[], int nbytes, int stride, int first, int nblocks, unsigned char syn[])
+{
+  __m256i m[NPAR], acc[NPAR], r[16];
+  int k, i, q, j;
+
+  if (nbytes % 16)
+    return first;
+
+  for (j = 0; j < NPAR; j++)
+    m[j] = _mm256_set1_epi64x((long long) synAffine[SYN_BLOCKS+3][j][0]);
+
+  for (k = first; k + 32 <= nblocks; k += 32) {
+    for (j = 0; j < NPAR; j++)
+      acc[j] = _mm256_setzero_si256();
+
+    for (i = 0; i < nbytes; i += 16) {
+      for (q = 0; q < 16; q++)
+        r[q] = SYN_LOAD2(data + (k+q)*stride + i, stride);
+      SYN_TRANSPOSE(__m256i, r, _mm256_unpacklo_epi8, _mm256_unpackhi_epi8, _mm256_unpacklo_epi16, _mm256_unpackhi_epi16,
+                    _mm256_unpacklo_epi32, _mm256_unpackhi_epi32, _mm256_unpacklo_epi64, _mm256_unpackhi_epi64);
+
+      for (q = 0; q < 16; q++)
+        for (j = 0; j < NPAR; j++)
+          acc[j] = _mm256_xor_si256(r[q], _mm256_gf2p8affine_epi64_epi8(acc[j], m[j], 0));
+    }
+
+    for (j = 0; j < NPAR; j++)
+      _mm256_storeu_si256((__m256i *) (syn + j*nblocks + k), acc[j]);
+  }
+  return syndromes_batch_ssse3(data, nbytes, stride, k, nblocks, syn);
+}
+
+
+/* codewords q, q+16, q+32 and q+48 in the four 128 bit lanes */
+#define SYN_LOAD4(p, stride) \
+  _mm512_inserti32x4(_mm512_inserti32x4(_mm512_inserti32x4(_mm512_castsi128_si512(_mm_loadu_si128((__m128i *) (p))), \
+                     _mm_loadu_si128((__m128i *) ((p) + 16*(stride))), 1), \
+                     _mm_loadu_si128((__m128i *) ((p) + 32*(stride))), 2), \
+                     _mm_loadu_si128((__m128i *) ((p) + 48*(stride))), 3)
+
+__attribute__((target("avx512f,avx512bw")))
+static int
+syndromes_batch_avx512 (unsigned char data[], int nbytes, int stride, int first, int nblocks, unsigned char syn[])
+{
+  const __m512i mask = _mm512_set1_epi8(0x0f);
+  __m512i lo[NPAR], hi[NPAR], acc[NPAR], r[16];
+  int k, i, q, j;
+
+  if (nbytes % 16)
+    return first;
+
+  for (j = 0; j < NPAR; j++) {
+    lo[j] = _mm512_broadcast_i32x4(_mm_load_si128((__m128i *) synMulLo[SYN_BLOCKS+3][j]));
+    hi[j] = _mm512_broadcast_i32x4(_mm_load_si128((__m128i *) synMulHi[SYN_BLOCKS+3][j]));
+  }
+
+  for (k = first; k + 64 <= nblocks; k += 64) {
+    for (j = 0; j < NPAR; j++)
+      acc[j] = _mm512_setzero_si512();
+
+    for (i = 0; i < nbytes; i += 16) {
+      for (q = 0; q < 16; q++)
+        r[q] = SYN_LOAD4(data + (k+q)*stride + i, stride);
+      SYN_TRANSPOSE(__m512i, r, _mm512_unpacklo_epi8, _mm512_unpackhi_epi8, _mm512_unpacklo_epi16, _mm512_unpackhi_epi16,
+                    _mm512_unpacklo_epi32, _mm512_unpackhi_epi32, _mm512_unpacklo_epi64, _mm512_unpackhi_epi64);
+
+      for (q = 0; q < 16; q++)
+        for (j = 0; j < NPAR; j++)
+          acc[j] = _mm512_xor_si512(r[q], _mm512_xor_si512(_mm512_shuffle_epi8(lo[j], _mm512_and_si512(acc[j], mask)),
+                                                           _mm512_shuffle_epi8(hi[j], _mm512_and_si512(_mm512_srli_epi16(acc[j], 4), mask))));
+    }
+
+    for (j = 0; j < NPAR; j++)
+      _mm512_storeu_si512(syn + j*nblocks + k, acc[j]);
+  }
+  return syndromes_batch_avx2(data, nbytes, stride, k, nblocks, syn);
+}
+
+
+__attribute__((target("gfni,avx512f,avx512bw")))
+static int
+syndromes_batch_gfni512 (unsigned char data[], int nbytes, int stride, int first, int nblocks, unsigned char syn[])
+{
+  __m512i m[NPAR], acc[NPAR], r[16];
+  int k, i, q, j;
+
+  if (nbytes % 16)
+    return first;
+
+  for (j = 0; j < NPAR; j++)
+    m[j] = _mm512_set1_epi64((long long) synAffine[SYN_BLOCKS+3][j][0]);
+
+  for (k = first; k + 64 <= nblocks; k += 64) {
+    for (j = 0; j < NPAR; j++)
+      acc[j] = _mm512_setzero_si512();
+
+    for (i = 0; i < nbytes; i += 16) {
+      for (q = 0; q < 16; q++)
+        r[q] = SYN_LOAD4(data + (k+q)*stride + i, stride);
+      SYN_TRANSPOSE(__m512i, r, _mm512_unpacklo_epi8, _mm512_unpackhi_epi8, _mm512_unpacklo_epi16, _mm512_unpackhi_epi16,
+                    _mm512_unpacklo_epi32, _mm512_unpackhi_epi32, _mm512_unpacklo_epi64, _mm512_unpackhi_epi64);
+
+      for (q = 0; q < 16; q++)
+        for (j = 0; j < NPAR; j++)
+          acc[j] = _mm512_xor_si512(r[q], _mm512_gf2p8affine_epi64_epi8(acc[j], m[j], 0));
+    }
+
+    for (j = 0; j < NPAR; j++)
+      _mm512_storeu_si512(syn + j*nblocks + k, acc[j]);
+  }
+  return syndromes_batch_gfni(data, nbytes, stride, k, nblocks, syn);
+}
+
+
+/* Pick the widest kernels this CPU supports, up to tier max_tier
+   (SYN_TIER_...).  Returns the tier picked. */
+int
+select_syndrome_kernels (int max_tier)
+{
+  __builtin_cpu_init();
+  if (max_tier >= SYN_TIER_AVX512 && __builtin_cpu_supports("avx512bw")) {
+    if (__builtin_cpu_supports("gfni")) {
+      syndrome_kernel = syndromes_gfni;
+      syndrome_batch_kernel = syndromes_batch_gfni512;
+    }
+    else {
+      syndrome_kernel = syndromes_avx2;
+      syndrome_batch_kernel = syndromes_batch_avx512;
+    }
+    return SYN_TIER_AVX512;
+  }
+  if (max_tier >= SYN_TIER_GFNI && __builtin_cpu_supports("gfni") && __builtin_cpu_supports("avx2")) {
+    syndrome_kernel = syndromes_gfni;
+    syndrome_batch_kernel = syndromes_batch_gfni;
+    return SYN_TIER_GFNI;
+  }
+  if (max_tier >= SYN_TIER_AVX2 && __builtin_cpu_supports("avx2")) {
+    syndrome_kernel = syndromes_avx2;
+    syndrome_batch_kernel = syndromes_batch_avx2;
+    return SYN_TIER_AVX2;
+  }
+  if (max_tier >= SYN_TIER_SSSE3 && __builtin_cpu_supports("ssse3")) {
+    syndrome_kernel = syndromes_ssse3;
+    syndrome_batch_kernel = syndromes_batch_ssse3;
+    return SYN_TIER_SSSE3;
+  }
+
+  syndrome_kernel = 0;
+  syndrome_batch_kernel = 0;
+  return SYN_TIER_NONE;
+}
+
+
+/* Build the per-position constant tables and pick the widest kernel
+   this CPU supports - only the first time, so that kernels picked
+   (and checked) by the caller with select_syndrome_kernels() stay. */
+void
+init_syndrome_tables (void)
+{
+  static int done = 0;
+  int c, j, x;
+
+  if (done)
+    return;
+
+  memset(synMulLo, 0, sizeof(synMulLo));
+  memset(synMulHi, 0, sizeof(synMulHi));
+  memset(synAffine, 0, sizeof(synAffine));
+
+  for (j = 0; j < NPAR; j++) {
+    for (c = 0; c < SYN_NCONST; c++) {
+      /* exponent of b = alpha^(j+1): 16e for the block constants, 8 >> f for the folds */
+      int e = (c < SYN_BLOCKS) ? 16*c : (8 >> (c - SYN_BLOCKS));
+      int k = gexp[((j+1) * e) % 255];
+
+      for (x = 0; x < 16; x++) {
+        synMulLo[c][j][x] = gmult(k, x);
+        synMulHi[c][j][x] = gmult(k, x << 4);
+      }
+      synAffine[c][j][0] = synAffine[c][j][1] = affine_matrix(k);
+    }
+  }
+
+  select_syndrome_kernels(SYN_TIER_MAX);
+  done = 1;
+}
+
+#else
+
+/* no vector kernels for this architecture - decode_data() uses Horner's rule */
+int
+select_syndrome_kernels (int max_tier)
+{
+  syndrome_kernel = 0;
+  syndrome_batch_kernel = 0;
+  return SYN_TIER_NONE;
+}
+
+void
+init_syndrome_tables (void)
+{
+  select_syndrome_kernels(SYN_TIER_MAX);
+}
+
+#endif
@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stream.h"
+
+
+// set up a stream decoding with dec (which must have been set up by oob_decoder_init())
+// ring_bytes is rounded up to a power of 2, at least 2 frames' worth (2*OOB_STREAM_MIRROR) and a page
+// return value: 0 if successful, negative value if the ring could not be allocated
+int oob_stream_init( oob_stream *s, oob_decoder *dec, int ring_bytes )
+{
+    uint32_t size = 1;
+
+
+    memset( s, 0, sizeof(*s) );
+
+    while( size < (uint32_t)ring_bytes || size < 2*OOB_STREAM_MIRROR || size < (uint32_t)sysconf( _SC_PAGESIZE ) )
+        size <<= 1;
+
+    if( oob_arena_alloc_ring( &s->ring, size ) == 0 )
+        s->span = 2*size;
+    else if( oob_arena_alloc( &s->ring, size + OOB_STREAM_MIRROR ) == 0 )
+        s->span = size + OOB_STREAM_MIRROR;
+    else
+        return -1;
+
+    s->buf = s->ring.base;
+    s->dec = dec;
+    s->size = size;
+
+
+    return 0;
+}
+
+
+void oob_stream_free( oob_stream *s )
+{
+    oob_arena_free( &s->ring );
+    oob_arena_free( &s->flag_ring );
+    s->buf = NULL;
+    s->flags = NULL;
+}
+
+
+// keep erasure flags alongside the bitstream - bytes fed with oob_stream_feed() are flagged as reliable
+// return value: 0 if successful, negative value if the flag ring could not be allocated
+int oob_stream_enable_erasures( oob_stream *s )
+{
+    if( s->flags )
+        return 0;
+
+    // laid out like buf[] - mirrored the same way
+    if( s->ring.mirrored ? oob_arena_alloc_ring( &s->flag_ring, s->size ) : oob_arena_alloc( &s->flag_ring, s->span ) )
+        return -1;
+    memset( s->flag_ring.base, 0, s->ring.mirrored ? s->size : s->span );
+    s->flags = s->flag_ring.base;
+
+
+    return 0;
+}
+
+
+// where the flags of the bytes at oob_stream_write_ptr() go - valid for the same *len bytes, before oob_stream_commit()
+uint8_t *oob_stream_flags_ptr( oob_stream *s )
+{
+    return s->flags + ((uint32_t)s->head & (s->size - 1));
+}
+
+
+// zero-copy alternative to oob_stream_feed() - write up to *len bytes to the returned pointer, then oob_stream_commit() them
+// *len is 0 if the ring is full
+uint8_t *oob_stream_write_ptr( oob_stream *s, int *len )
+{
+    uint32_t pos = (uint32_t)s->head & (s->size - 1);
+    uint32_t space = s->size - (uint32_t)(s->head - s->tail);
+
+
+    // a mirrored ring takes a write across its end, else up to the end - the next write starts again at the beginning
+    *len = space;
+    if( !s->ring.mirrored && *len > s->size - pos )
+        *len = s->size - pos;
+
+
+    return s->buf + pos;
+}
+
+
+void oob_stream_commit( oob_stream *s, int len )
+{
+    uint32_t pos = (uint32_t)s->head & (s->size - 1);
+    int n;
+
+
+    if( pos < OOB_STREAM_MIRROR && !s->ring.mirrored )
+    {   // keep the mirror past the end of the ring up to date
+        n = OOB_STREAM_MIRROR - pos;
+        if( n > len )
+            n = len;
+        memcpy( s->buf + s->size + pos, s->buf + pos, n );
+        if( s->flags )
+            memcpy( s->flags + s->size + pos, s->flags + pos, n );
+    }
+
+    s->head += len;
+    s->dec->in_byte_count += len;
+}
+
+
+// copy up to len bytes of bitstream into the stream
+// return value: # of bytes taken - less than len if the ring is full (read packets to make room)
+int oob_stream_feed( oob_stream *s, const uint8_t *buf, int len )
+{
+    uint8_t *dst;
+    int fed = 0;
+    int n;
+
+
+    // at most twice - up to the end of the ring, then from its start
+    while( fed < len )
+    {
+        dst = oob_stream_write_ptr( s, &n );
+        if( n == 0 )
+            break;
+        if( n > len - fed )
+            n = len - fed;
+
+        memcpy( dst, buf + fed, n );
+        if( s->flags )
+            memset( oob_stream_flags_ptr( s ), 0, n );
+        oob_stream_commit( s, n );
+        fed += n;
+    }
+
+
+    return fed;
+}
+
+
+// find the next frame in the ring with the sync tracker, starting where the last search stopped
+// the part of the ring from tail on that is contiguous in buf[] (including the mirror) is searched at a time - all of
+// it if the ring is mirrored
+// return value: offset of the frame in buf[] - 1152 bytes from there are valid - or -1 if more bitstream is needed
+static int oob_stream_next_frame( oob_stream *s )
+{
+    uint32_t start;
+    int avail;
+    int len;
+    int ofs;
+    int resume;
+#ifdef OOB_PROFILE
+    uint64_t tail = s->tail;
+#endif
+    OOB_PROF_START( t );
+
+
+    for( ;; )
+    {
+        start = (uint32_t)s->tail & (s->size - 1);
+        avail = (int)(s->head - s->tail);
+        len = s->span - start;
+        if( len > avail )
+            len = avail;
+
+        s->dec->sync.stream_pos = s->tail;
+        ofs = oob_sync_next_frame( &s->dec->sync, s->buf + start, 0, len, &resume );
+        if( ofs >= 0 )
+        {
+            s->tail += ofs + 384;
+            OOB_PROF_LAP( &s->dec->prof, OOB_PROF_SYNC, t, s->tail - tail );
+            return start + ofs;
+        }
+
+        s->tail += resume;
+        if( len == avail || resume == 0 )
+        {   // everything fed so far has been looked at
+            OOB_PROF_LAP( &s->dec->prof, OOB_PROF_SYNC, t, s->tail - tail );
+            return -1;
+        }
+    }
+}
+
+
+// decode up to max 188-byte TS packets into out[]
+// return value: # of packets placed in out[] - 0 if more bitstream has to be fed first
+int oob_stream_read_packets( oob_stream *s, uint8_t *out, int max )
+{
+    int frame_ofs[OOB_STREAM_BATCH];
+    int nframes;
+    int ofs = 0;
+    int kept;
+    int n = 0;
+
+
+    if( s->nheld && max > 0 )
+    {
+        memcpy( out, s->held + 188, 188 );
+        s->nheld = 0;
+        n++;
+    }
+
+    // find a batch of frames, then decode them all straight into out[] (on the decoder's frame threads if it has any)
+    while( ofs >= 0 && max - n >= 2 )
+    {
+        for( nframes=0; nframes < OOB_STREAM_BATCH && nframes < (max-n)/2; nframes++ )
+        {
+            if( (ofs = oob_stream_next_frame( s )) < 0 )
+                break;
+            frame_ofs[nframes] = ofs;
+        }
+
+        n += oob_decode_frames( s->dec, s->buf, s->flags, frame_ofs, nframes, out + n*188 );
+    }
+
+    // room for one packet only - keep the frame's second packet for the next call
+    // (a PID filter may drop both packets of a frame, then look at the next one)
+    while( ofs >= 0 && max - n == 1 && (ofs = oob_stream_next_frame( s )) >= 0 )
+    {
+        oob_decode_frame_erasures( s->dec, s->buf + ofs, s->flags ? s->flags + ofs : NULL, s->held );
+        kept = oob_decoder_filter_packets( s->dec, s->held, 2 );
+        if( kept == 0 )
+            continue;
+        memcpy( out + n*188, s->held, 188 );
+        s->nheld = kept - 1;            // both kept - the second is still at held + 188
+        n++;
+    }
+
+
+    return n;
+}
@@ -0,0 +1,87 @@
+#ifndef _STREAM_H
+#define _STREAM_H
+
+#include <stdint.h>
+
+#include "oobin.h"
+#include "arena.h"
+
+
+//---------------------------
+// Push / pull streaming API
+//---------------------------
+//
+// bitstream bytes are pushed in with oob_stream_feed() (or written straight into the stream with
+// oob_stream_write_ptr() / oob_stream_commit()) in any amounts, TS packets are pulled out with oob_stream_read_packets()
+//
+// the stream keeps the bitstream in a ring buffer - nothing is moved once it is in the ring:
+// the ring is mapped a second time right past its end (a ring arena, see arena.h), so a frame (which needs 1152 bytes,
+// see oob_decode_frame()) that wraps around the end of the ring can still be decoded in place, and a write or a sync
+// search can run across the end in one piece
+// where the ring can't be mapped twice, only its first OOB_STREAM_MIRROR bytes are mirrored past its end - copied
+// there as they are committed - which is all a frame needs
+// frame sync is followed by the sync tracker of the decoder, so every byte is searched once at most
+// frames are only decoded when packets are read, straight into the caller's buffer
+//
+// erasure flags from the demodulator (see oob_decode_frame_erasures()) can be kept in a second ring, in step with the
+// bitstream - write the flags of the bytes about to be committed to oob_stream_flags_ptr()
+
+
+#define OOB_STREAM_MIRROR       1152        // bytes behind a frame's start the decoder reads
+#define OOB_STREAM_BATCH        256         // frames found at a time before they are decoded (handed to oob_decode_frames() together)
+
+
+typedef struct oob_stream
+{
+    oob_decoder *dec;                       // sync tracker, FEC state and frame threads used to decode
+
+    oob_arena ring;
+    uint8_t *buf;                           // ring.base - valid for span bytes
+    uint32_t size;                          // power of 2
+    uint32_t span;                          // 2*size if the ring is mirrored by the VM, else size + OOB_STREAM_MIRROR
+    uint64_t head;                          // bytes of bitstream put in the ring so far
+    uint64_t tail;                          // position in the bitstream of the next byte not yet looked at by the sync tracker
+
+    oob_arena flag_ring;
+    uint8_t *flags;                         // erasure flags for each byte of buf[] (same layout, mirror included) - NULL if not used
+
+    uint8_t held[376];                      // second packet of a frame when only one packet fit in the caller's buffer
+    int nheld;
+} oob_stream;
+
+
+// set up a stream decoding with dec (which must have been set up by oob_decoder_init())
+// ring_bytes is rounded up to a power of 2, at least 2 frames' worth (2*OOB_STREAM_MIRROR) and a page
+// return value: 0 if successful, negative value if the ring could not be allocated
+int oob_stream_init( oob_stream *s, oob_decoder *dec, int ring_bytes );
+
+void oob_stream_free( oob_stream *s );
+
+
+// copy up to len bytes of bitstream into the stream
+// return value: # of bytes taken - less than len if the ring is full (read packets to make room)
+int oob_stream_feed( oob_stream *s, const uint8_t *buf, int len );
+
+
+// zero-copy alternative to oob_stream_feed() - write up to *len bytes to the returned pointer, then oob_stream_commit() them
+// *len is 0 if the ring is full - otherwise all the free space, or up to the end of the ring if it isn't mirrored
+uint8_t *oob_stream_write_ptr( oob_stream *s, int *len );
+
+void oob_stream_commit( oob_stream *s, int len );
+
+
+// keep erasure flags alongside the bitstream - bytes fed with oob_stream_feed() are flagged as reliable
+// return value: 0 if successful, negative value if the flag ring could not be allocated
+int oob_stream_enable_erasures( oob_stream *s );
+
+
+// where the flags of the bytes at oob_stream_write_ptr() go - valid for the same *len bytes, before oob_stream_commit()
+uint8_t *oob_stream_flags_ptr( oob_stream *s );
+
+
+// decode up to max 188-byte TS packets into out[]
+// return value: # of packets placed in out[] - 0 if more bitstream has to be fed first
+int oob_stream_read_packets( oob_stream *s, uint8_t *out, int max );
+
+
+#endif  // _STREAM_H
@@ -0,0 +1,290 @@
+#define _GNU_SOURCE                     // sendmmsg()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/random.h>
+
+#include "udpout.h"
+
+
+int oob_udp_is_url( const char *name )
+{
+    return !strncmp( name, "udp://", 6 ) || !strncmp( name, "rtp://", 6 );
+}
+
+
+// "udp://<host>:<port>" / "rtp://<host>:<port>" - an IPv6 host goes in brackets, "rtp://[::1]:5004"
+// return value: 0 if successful, negative value if url is not one of them or host can't be resolved
+static int oob_udp_resolve( const char *url, struct addrinfo **ai )
+{
+    char host[256];
+    const char *port;
+    struct addrinfo hints;
+    int len;
+
+
+    if( !oob_udp_is_url( url ) )
+        return -1;
+    url += 6;
+
+    port = strrchr( url, ':' );
+    if( !port || port == url || !port[1] )
+        return -1;
+    len = port - url;
+    if( url[0] == '[' && url[len-1] == ']' )
+    {
+        url++;
+        len -= 2;
+    }
+    if( len <= 0 || len >= (int)sizeof(host) )
+        return -1;
+    memcpy( host, url, len );
+    host[len] = 0;
+
+    memset( &hints, 0, sizeof(hints) );
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+
+    return getaddrinfo( host, port+1, &hints, ai ) ? -1 : 0;
+}
+
+
+int oob_udp_open( oob_udp_sink *u, const char *url, int sndbuf )
+{
+    struct addrinfo *ai = NULL;
+    struct timespec now;
+    uint32_t rnd[2];
+    unsigned int seed;
+
+
+    memset( u, 0, sizeof(*u) );
+    u->fd = -1;
+    u->rtp = !strncmp( url, "rtp://", 6 );
+
+    if( oob_udp_resolve( url, &ai ) < 0 )
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    u->fd = socket( ai->ai_family, SOCK_DGRAM, 0 );
+    if( u->fd < 0 || connect( u->fd, ai->ai_addr, ai->ai_addrlen ) < 0 )
+        goto end_fail;
+
+    // SO_SNDBUF is capped at net.core.wmem_max - past that only root can have it (SO_SNDBUFFORCE)
+    if( sndbuf > 0 )
+    {
+        setsockopt( u->fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf) );
+        if( oob_udp_sndbuf( u ) < sndbuf )
+            setsockopt( u->fd, SOL_SOCKET, SO_SNDBUFFORCE, &sndbuf, sizeof(sndbuf) );
+    }
+
+    u->msgs = (struct mmsghdr *)calloc( OOB_UDP_BATCH, sizeof(struct mmsghdr) );
+    u->iov = (struct iovec *)calloc( OOB_UDP_BATCH * 3, sizeof(struct iovec) );
+    u->rtp_hdr = (uint8_t *)calloc( OOB_UDP_BATCH, OOB_RTP_HEADER );
+    if( !u->msgs || !u->iov || !u->rtp_hdr )
+    {
+        errno = ENOMEM;
+        goto end_fail;
+    }
+
+    // random first sequence # and SSRC, as RFC 3550 asks - a restarted decoder is a new source to the receiver
+    // (from a seed of its own, the process' rand() is left alone)
+    if( getrandom( rnd, sizeof(rnd), GRND_NONBLOCK ) != sizeof(rnd) )
+    {   // no entropy pool yet at early boot - the clock, pid and sink tell restarts and streams apart well enough
+        clock_gettime( CLOCK_REALTIME, &now );
+        seed = now.tv_nsec ^ now.tv_sec ^ getpid() ^ (uintptr_t)u;
+        rnd[0] = rand_r( &seed );
+        rnd[1] = ((uint32_t)rand_r( &seed ) << 16) ^ rand_r( &seed );
+    }
+    u->rtp_seq = rnd[0];
+    u->rtp_ssrc = rnd[1];
+
+    freeaddrinfo( ai );
+
+
+    return 0;
+
+
+end_fail:
+    freeaddrinfo( ai );
+    if( u->fd >= 0 )
+        close( u->fd );
+    u->fd = -1;
+    free( u->msgs );
+    free( u->iov );
+    free( u->rtp_hdr );
+    u->msgs = NULL;
+    u->iov = NULL;
+    u->rtp_hdr = NULL;
+
+
+    return -1;
+}
+
+
+int oob_udp_sndbuf( const oob_udp_sink *u )
+{
+    int size = 0;
+    socklen_t len = sizeof(size);
+
+
+    getsockopt( u->fd, SOL_SOCKET, SO_SNDBUF, &size, &len );
+
+
+    return size;
+}
+
+
+// queue a datagram of the held packets followed by npackets packets at ts - ts[] has to stay put until it is sent
+static void oob_udp_queue( oob_udp_sink *u, const uint8_t *ts, int npackets )
+{
+    struct mmsghdr *msg = &u->msgs[u->nmsgs];
+    struct iovec *iov = &u->iov[u->nmsgs * 3];
+    uint8_t *hdr = &u->rtp_hdr[u->nmsgs * OOB_RTP_HEADER];
+    int niov = 0;
+
+
+    if( u->rtp )
+    {   // V=2, no padding / extension / CSRCs, M=0 - the timestamp is filled in when the batch is sent
+        hdr[0] = 0x80;
+        hdr[1] = OOB_RTP_PT_MP2T;
+        hdr[2] = u->rtp_seq >> 8;
+        hdr[3] = u->rtp_seq;
+        hdr[8] = u->rtp_ssrc >> 24;
+        hdr[9] = u->rtp_ssrc >> 16;
+        hdr[10] = u->rtp_ssrc >> 8;
+        hdr[11] = u->rtp_ssrc;
+        u->rtp_seq++;
+
+        iov[niov].iov_base = hdr;
+        iov[niov++].iov_len = OOB_RTP_HEADER;
+    }
+    if( u->nheld )
+    {
+        iov[niov].iov_base = u->held;
+        iov[niov++].iov_len = u->nheld * 188;
+    }
+    if( npackets )
+    {
+        iov[niov].iov_base = (void *)ts;
+        iov[niov++].iov_len = npackets * 188;
+    }
+
+    memset( msg, 0, sizeof(*msg) );
+    msg->msg_hdr.msg_iov = iov;
+    msg->msg_hdr.msg_iovlen = niov;
+    u->nmsgs++;
+}
+
+
+// send the queued datagrams, as few sendmmsg() calls as it takes
+// return value: 0 if successful, negative value on a send error
+static int oob_udp_flush( oob_udp_sink *u )
+{
+    struct timespec now;
+    uint32_t stamp;
+    uint8_t *hdr;
+    int sent = 0;
+    int n;
+
+
+    if( u->rtp )
+    {   // 90 kHz clock - RFC 2250 has it stamp the target transmission time, which is now for a live decoder
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        stamp = (uint32_t)((uint64_t)now.tv_sec * 90000 + now.tv_nsec / 11111);
+        for( n=0; n<u->nmsgs; n++ )
+        {
+            hdr = &u->rtp_hdr[n * OOB_RTP_HEADER];
+            hdr[4] = stamp >> 24;
+            hdr[5] = stamp >> 16;
+            hdr[6] = stamp >> 8;
+            hdr[7] = stamp;
+        }
+    }
+
+    while( sent < u->nmsgs )
+    {
+        n = sendmmsg( u->fd, u->msgs + sent, u->nmsgs - sent, 0 );
+        if( n < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            if( errno == ECONNREFUSED )
+            {   // an earlier datagram bounced - the error has been reported now, nothing of this call went out, send it again
+                u->refused++;
+                continue;
+            }
+            return -1;
+        }
+        sent += n;
+        u->datagrams += n;
+    }
+    u->nmsgs = 0;
+
+
+    return 0;
+}
+
+
+int oob_udp_write( oob_udp_sink *u, const uint8_t *ts, int npackets )
+{
+    int take;
+    int n = 0;
+
+
+    while( u->nheld + npackets - n >= OOB_UDP_PACKETS )
+    {
+        take = OOB_UDP_PACKETS - u->nheld;
+        oob_udp_queue( u, ts + n*188, take );
+        u->nheld = 0;                   // held[] is still in the first datagram, it is only refilled below once that is sent
+        n += take;
+
+        if( u->nmsgs == OOB_UDP_BATCH && oob_udp_flush( u ) < 0 )
+            return -1;
+    }
+    if( u->nmsgs && oob_udp_flush( u ) < 0 )
+        return -1;
+
+    memcpy( u->held + u->nheld*188, ts + n*188, (npackets - n) * 188 );
+    u->nheld += npackets - n;
+
+
+    return 0;
+}
+
+
+int oob_udp_close( oob_udp_sink *u )
+{
+    int ret = 0;
+
+
+    if( u->fd < 0 )
+        return 0;
+
+    if( u->nheld )
+    {
+        oob_udp_queue( u, NULL, 0 );
+        ret = oob_udp_flush( u );
+        u->nheld = 0;
+    }
+
+    close( u->fd );
+    u->fd = -1;
+    free( u->msgs );
+    free( u->iov );
+    free( u->rtp_hdr );
+    u->msgs = NULL;
+    u->iov = NULL;
+    u->rtp_hdr = NULL;
+
+
+    return ret;
+}
@@ -0,0 +1,75 @@
+#ifndef _UDPOUT_H
+#define _UDPOUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+
+//---------------------------
+// UDP / RTP output
+//---------------------------
+//
+// TS packets sent straight to the network instead of a file - "udp://<host>:<port>" or "rtp://<host>:<port>"
+// each datagram carries OOB_UDP_PACKETS TS packets (7 x 188 = 1316 bytes, the most that fits an Ethernet MTU), the
+// rtp:// form puts an RTP header in front of each (RFC 2250 - payload type 33, MPEG-2 TS, 90 kHz timestamp)
+// the packets are not copied into datagrams: each datagram is an iovec pointing at them where the decoder put them,
+// the datagrams are queued in an mmsghdr array and handed to the kernel up to OOB_UDP_BATCH at a time by one
+// sendmmsg() call - only the packets left over at the end of a write that don't make a whole datagram are copied,
+// they go out at the front of the first datagram of the next write
+// the socket is connected, so nothing but the destination's port being closed (ECONNREFUSED, from the ICMP reply to
+// an earlier datagram) can make a send fail on its own - the failed sendmmsg() is counted as refused and the datagrams
+// it didn't send are sent again (the datagram the ICMP reply was for is lost), a receiver starting late or restarting
+// doesn't stop the decoder
+
+
+#define OOB_UDP_PACKETS         7           // TS packets per datagram
+#define OOB_UDP_BATCH           64          // datagrams per sendmmsg()
+#define OOB_RTP_HEADER          12          // bytes
+#define OOB_RTP_PT_MP2T         33          // RTP payload type of MPEG-2 TS (RFC 3551)
+
+
+struct mmsghdr;
+struct iovec;
+
+typedef struct oob_udp_sink
+{
+    int fd;
+    int rtp;                            // put an RTP header in front of each datagram
+    uint16_t rtp_seq;
+    uint32_t rtp_ssrc;
+
+    uint8_t held[OOB_UDP_PACKETS*188];  // packets left over from the last write, short of a whole datagram
+    int nheld;
+
+    struct mmsghdr *msgs;               // [OOB_UDP_BATCH] datagrams queued for the next sendmmsg()
+    struct iovec *iov;                  // [OOB_UDP_BATCH][3] RTP header, held packets, new packets
+    uint8_t *rtp_hdr;                   // [OOB_UDP_BATCH][OOB_RTP_HEADER]
+    int nmsgs;
+
+    uint64_t datagrams;                 // sent
+    uint64_t refused;                   // sends that failed with ECONNREFUSED (and were retried) - the port was closed
+} oob_udp_sink;
+
+
+// 1 if name is a "udp://" or "rtp://" destination rather than a file name
+int oob_udp_is_url( const char *name );
+
+// resolve url and open a connected UDP socket to it
+// sndbuf - socket send buffer size in bytes (SO_SNDBUF), 0 = the system default
+// return value: 0 if successful, negative value if url is not "udp://<host>:<port>" / "rtp://<host>:<port>" or the
+//               socket could not be opened (errno is set then)
+int oob_udp_open( oob_udp_sink *u, const char *url, int sndbuf );
+
+// send npackets TS packets - every whole datagram now, the rest held back for the next write or oob_udp_close()
+// return value: 0 if successful, negative value on a send error
+int oob_udp_write( oob_udp_sink *u, const uint8_t *ts, int npackets );
+
+// send the packets held back as one last, shorter datagram and close the socket
+// return value: 0 if successful, negative value on a send error
+int oob_udp_close( oob_udp_sink *u );
+
+// the send buffer size the kernel actually gave the socket, in bytes
+int oob_udp_sndbuf( const oob_udp_sink *u );
+
+
+#endif  // _UDPOUT_H
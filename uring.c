@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "uring.h"
+#include "stream.h"
+#include "arena.h"
+
+
+// user_data of each request - which queue it belongs to and its slot
+#define OOB_URING_READ          0x10000
+#define OOB_URING_WRITE         0x20000
+#define OOB_URING_SLOT          0x0ffff
+
+// bytes before the stream's tail the decoder may still be reading (the frame it just found) - kept clear of reads
+#define OOB_URING_GUARD         384
+
+
+typedef struct oob_uring
+{
+    int fd;
+
+    // submission queue (shared with the kernel)
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned to_submit;                     // sqes filled in since the last io_uring_enter()
+
+    // completion queue (shared with the kernel)
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+} oob_uring;
+
+
+// one read or write request
+typedef struct oob_uring_io
+{
+    int busy;                               // reads: issued and not committed to the stream yet, writes: in flight
+    int done;                               // reads: complete, waiting to be committed in file order
+    uint8_t *buf;
+    int len;                                // # of bytes to read / write
+    int got;                                // # of bytes read / written so far
+    uint64_t off;                           // file offset of buf[0]
+    int buf_index;                          // registered buffer buf[] is in
+} oob_uring_io;
+
+
+static int oob_uring_setup( oob_uring *u, unsigned entries )
+{
+    struct io_uring_params p;
+
+
+    memset( u, 0, sizeof(*u) );
+    memset( &p, 0, sizeof(p) );
+
+    u->fd = (int)syscall( __NR_io_uring_setup, entries, &p );
+    if( u->fd < 0 )
+        return -1;
+
+    u->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if( p.features & IORING_FEAT_SINGLE_MMAP )
+    {   // both rings are in one mapping
+        if( u->cq_size > u->sq_size )
+            u->sq_size = u->cq_size;
+        u->cq_size = 0;
+    }
+
+    u->sq_ptr = mmap( NULL, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING );
+    if( u->sq_ptr == MAP_FAILED )
+        goto end_close;
+
+    if( u->cq_size )
+    {
+        u->cq_ptr = mmap( NULL, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING );
+        if( u->cq_ptr == MAP_FAILED )
+            goto end_unmap_sq;
+    }
+    else
+        u->cq_ptr = u->sq_ptr;
+
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = (struct io_uring_sqe *)mmap( NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES );
+    if( u->sqes == MAP_FAILED )
+        goto end_unmap_cq;
+
+    u->sq_head = (unsigned *)((uint8_t *)u->sq_ptr + p.sq_off.head);
+    u->sq_tail = (unsigned *)((uint8_t *)u->sq_ptr + p.sq_off.tail);
+    u->sq_mask = (unsigned *)((uint8_t *)u->sq_ptr + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)((uint8_t *)u->sq_ptr + p.sq_off.array);
+    u->cq_head = (unsigned *)((uint8_t *)u->cq_ptr + p.cq_off.head);
+    u->cq_tail = (unsigned *)((uint8_t *)u->cq_ptr + p.cq_off.tail);
+    u->cq_mask = (unsigned *)((uint8_t *)u->cq_ptr + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)((uint8_t *)u->cq_ptr + p.cq_off.cqes);
+
+
+    return 0;
+
+
+end_unmap_cq:
+    if( u->cq_size )
+        munmap( u->cq_ptr, u->cq_size );
+end_unmap_sq:
+    munmap( u->sq_ptr, u->sq_size );
+end_close:
+    close( u->fd );
+
+    return -1;
+}
+
+
+static void oob_uring_teardown( oob_uring *u )
+{
+    munmap( u->sqes, u->sqes_size );
+    if( u->cq_size )
+        munmap( u->cq_ptr, u->cq_size );
+    munmap( u->sq_ptr, u->sq_size );
+    close( u->fd );
+}
+
+
+// queue a read / write of io->buf + io->got at io->off + io->got (or the current file position if off is -1)
+// the submission queue has room for every request that can be in flight, so this never fails
+static void oob_uring_queue( oob_uring *u, int fd, int write, int fixed, oob_uring_io *io, int slot, int seekable )
+{
+    struct io_uring_sqe *sqe;
+    unsigned tail = *u->sq_tail;
+    unsigned idx = tail & *u->sq_mask;
+
+
+    sqe = &u->sqes[idx];
+    memset( sqe, 0, sizeof(*sqe) );
+
+    if( fixed )
+    {
+        sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = io->buf_index;
+    }
+    else
+        sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)(io->buf + io->got);
+    sqe->len = io->len - io->got;
+    sqe->off = seekable ? io->off + io->got : (uint64_t)-1;
+    sqe->user_data = (write ? OOB_URING_WRITE : OOB_URING_READ) | slot;
+
+    u->sq_array[idx] = idx;
+    __atomic_store_n( u->sq_tail, tail + 1, __ATOMIC_RELEASE );
+    u->to_submit++;
+}
+
+
+// submit everything queued and wait for at least one completion
+static int oob_uring_enter( oob_uring *u )
+{
+    int ret;
+
+
+    do
+        ret = (int)syscall( __NR_io_uring_enter, u->fd, u->to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0 );
+    while( ret < 0 && errno == EINTR );
+
+    if( ret < 0 )
+        return -1;
+
+    u->to_submit -= ret;
+
+
+    return 0;
+}
+
+
+// decode in_fd into out_fd, reading chunk_bytes at a time with up to depth reads and depth writes in flight
+// return value: 0 if successful, -1 if io_uring is not available (nothing has been read then, the caller can fall back
+//               to stdio), -2 on read / write error
+int oob_uring_run( int in_fd, int out_fd, int chunk_bytes, int depth, oob_decoder *dec )
+{
+    oob_uring u;
+    oob_stream stream;
+    oob_uring_io rd[OOB_URING_MAX_DEPTH];
+    oob_uring_io wr[OOB_URING_MAX_DEPTH];
+    struct iovec iov[1 + OOB_URING_MAX_DEPTH];
+    struct io_uring_cqe *cqe;
+    oob_uring_io *io;
+    oob_arena out_arena;                    // the output buffers
+    uint8_t *out;
+    int out_packets;                        // TS packets per write
+    int rd_depth, wr_depth;
+    int rd_first = 0;                       // oldest read not committed yet - reads are issued and committed round-robin
+    int rd_next = 0;                        // next read slot to issue
+    int rd_busy = 0;
+    int wr_busy = 0;
+    uint64_t reserve;                       // stream position up to which reads have been issued
+    off_t in_off, out_off;
+    int in_seekable, out_seekable;
+    int fixed;
+    int eof = 0;
+    int ret = 0;
+    unsigned head;
+    int space;
+    int n, k;
+
+
+    if( depth < 1 )
+        depth = 1;
+    if( depth > OOB_URING_MAX_DEPTH )
+        depth = OOB_URING_MAX_DEPTH;
+    if( chunk_bytes < 2*1152 )
+        chunk_bytes = 2*1152;
+
+    in_off = lseek( in_fd, 0, SEEK_CUR );
+    in_seekable = in_off != (off_t)-1;
+    out_off = lseek( out_fd, 0, SEEK_CUR );
+    out_seekable = out_off != (off_t)-1;
+    rd_depth = in_seekable ? depth : 1;
+    wr_depth = out_seekable ? depth : 1;
+
+    if( oob_uring_setup( &u, 2*depth ) < 0 )
+        return -1;
+
+    // room for every read in flight plus the frames the decoder is working through
+    if( oob_stream_init( &stream, dec, (rd_depth + 2) * chunk_bytes + OOB_URING_GUARD ) < 0 )
+    {
+        oob_uring_teardown( &u );
+        return -2;
+    }
+
+    out_packets = 2 * (chunk_bytes/384 + 1);
+    if( oob_arena_alloc( &out_arena, wr_depth * out_packets * 188 ) < 0 )
+    {
+        oob_stream_free( &stream );
+        oob_uring_teardown( &u );
+        return -2;
+    }
+    out = out_arena.base;
+
+    memset( rd, 0, sizeof(rd) );
+    memset( wr, 0, sizeof(wr) );
+    for( k=0; k<wr_depth; k++ )
+    {
+        wr[k].buf = out + k * out_packets * 188;
+        wr[k].buf_index = 1 + k;
+    }
+
+    // the stream's ring and the output buffers are registered once, so the kernel doesn't map them for every request
+    // without registered buffers (RLIMIT_MEMLOCK too low, ...) the plain read / write requests are used
+    iov[0].iov_base = stream.buf;
+    iov[0].iov_len = stream.span;
+    for( k=0; k<wr_depth; k++ )
+    {
+        iov[1 + k].iov_base = wr[k].buf;
+        iov[1 + k].iov_len = out_packets * 188;
+    }
+    fixed = syscall( __NR_io_uring_register, u.fd, IORING_REGISTER_BUFFERS, iov, 1 + wr_depth ) == 0;
+
+    reserve = stream.head;
+
+
+    for( ;; )
+    {
+        // 1. write out every TS packet decoded so far, while there is a free output buffer
+        for( k=0; !ret && k<wr_depth && wr_busy < wr_depth; k++ )
+        {
+            if( wr[k].busy )
+                continue;
+
+            n = oob_stream_read_packets( &stream, wr[k].buf, out_packets );
+            if( n == 0 )
+                break;
+
+            wr[k].busy = 1;
+            wr[k].len = n * 188;
+            wr[k].got = 0;
+            wr[k].off = out_off;
+            oob_uring_queue( &u, out_fd, 1, fixed, &wr[k], k, out_seekable );
+
+            wr_busy++;
+            out_off += n * 188;
+        }
+
+        // 2. keep reads queued ahead of the decoder, each into the next free region of the stream's ring
+        //    (after the packets were pulled out, so the space the decoder just freed is used right away)
+        while( !eof && !ret && rd_busy < rd_depth )
+        {
+            // up to the end of the ring - a mirrored ring takes a read across its end
+            n = (stream.ring.mirrored ? 2*stream.size : stream.size) - (int)(reserve & (stream.size - 1));
+            space = stream.size - OOB_URING_GUARD - (int)(reserve - stream.tail);
+            if( n > space )
+                n = space;
+            if( n > chunk_bytes )
+                n = chunk_bytes;
+            if( n <= 0 )
+                break;
+
+            io = &rd[rd_next];
+            io->busy = 1;
+            io->done = 0;
+            io->buf = stream.buf + (reserve & (stream.size - 1));
+            io->len = n;
+            io->got = 0;
+            io->off = in_off;
+            io->buf_index = 0;
+            oob_uring_queue( &u, in_fd, 0, fixed, io, rd_next, in_seekable );
+
+            rd_next = (rd_next + 1) % rd_depth;
+            rd_busy++;
+            reserve += n;
+            in_off += n;
+        }
+
+        if( !rd_busy && !wr_busy )
+            break;
+
+        // 3. wait for something to complete
+        if( oob_uring_enter( &u ) < 0 )
+        {
+            fprintf( stderr, "Error - io_uring_enter() failed: %s\n", strerror( errno ) );
+            ret = -2;
+            break;
+        }
+
+        head = *u.cq_head;
+        while( head != __atomic_load_n( u.cq_tail, __ATOMIC_ACQUIRE ) )
+        {
+            cqe = &u.cqes[head & *u.cq_mask];
+            k = cqe->user_data & OOB_URING_SLOT;
+
+            if( cqe->user_data & OOB_URING_READ )
+            {
+                io = &rd[k];
+                if( cqe->res == -EINTR || cqe->res == -EAGAIN )
+                    oob_uring_queue( &u, in_fd, 0, fixed, io, k, in_seekable );
+                else if( cqe->res < 0 )
+                {
+                    fprintf( stderr, "Error reading input file: %s\n", strerror( -cqe->res ) );
+                    ret = -2;
+                    io->done = 1;
+                }
+                else if( cqe->res == 0 )
+                {   // end of file - reads queued after this one come back empty as well
+                    eof = 1;
+                    io->done = 1;
+                }
+                else
+                {
+                    io->got += cqe->res;
+                    if( io->got < io->len && in_seekable && !ret )
+                        oob_uring_queue( &u, in_fd, 0, fixed, io, k, in_seekable );     // short read - get the rest
+                    else
+                        io->done = 1;   // unseekable input - take what is there
+                }
+            }
+            else
+            {
+                io = &wr[k];
+                if( cqe->res == -EINTR || cqe->res == -EAGAIN )
+                    oob_uring_queue( &u, out_fd, 1, fixed, io, k, out_seekable );
+                else if( cqe->res <= 0 )
+                {
+                    fprintf( stderr, "Error writing output file: %s\n", cqe->res < 0 ? strerror( -cqe->res ) : "nothing written" );
+                    ret = -2;
+                    io->busy = 0;
+                    wr_busy--;
+                }
+                else
+                {
+                    io->got += cqe->res;
+                    if( io->got < io->len && !ret )
+                        oob_uring_queue( &u, out_fd, 1, fixed, io, k, out_seekable );   // short write - write the rest
+                    else
+                    {
+                        io->busy = 0;
+                        wr_busy--;
+                    }
+                }
+            }
+
+            head++;
+            __atomic_store_n( u.cq_head, head, __ATOMIC_RELEASE );
+        }
+
+        // 4. hand the reads to the stream in file order - a read can complete before the ones queued ahead of it
+        while( rd_busy && rd[rd_first].done )
+        {
+            if( !ret )
+                oob_stream_commit( &stream, rd[rd_first].got );
+            rd[rd_first].busy = 0;
+            rd_first = (rd_first + 1) % rd_depth;
+            rd_busy--;
+        }
+
+        // a short read (end of file, unseekable input) leaves the rest of its region unused
+        reserve = stream.head;
+        for( k=0; k<rd_depth; k++ )
+        {
+            if( rd[k].busy )
+                reserve += rd[k].len;
+        }
+    }
+
+
+    oob_uring_teardown( &u );
+    oob_arena_free( &out_arena );
+    oob_stream_free( &stream );
+
+
+    return ret;
+}
@@ -0,0 +1,30 @@
+#ifndef _URING_H
+#define _URING_H
+
+#include "oobin.h"
+
+
+//-------------------------
+// io_uring input / output
+//-------------------------
+//
+// a single-threaded event loop that keeps several reads queued ahead of the decoder and several writes in flight
+// behind it, using the io_uring system calls directly (no liburing needed)
+//
+// reads go straight into the ring buffer of an oob_stream (registered with the kernel as a fixed buffer), one region
+// per read, and are committed to the stream in file order as they complete - TS packets are pulled out of the
+// stream into registered output buffers and written while the next reads are still on their way in
+// a pipe or other unseekable input only has one read queued at a time (reads at the current file position can't be
+// reordered), likewise an unseekable output only one write
+
+
+#define OOB_URING_MAX_DEPTH     64          // reads / writes in flight at most
+
+
+// decode in_fd into out_fd, reading chunk_bytes at a time with up to depth reads and depth writes in flight
+// return value: 0 if successful, -1 if io_uring is not available (nothing has been read then, the caller can fall back
+//               to stdio), -2 on read / write error
+int oob_uring_run( int in_fd, int out_fd, int chunk_bytes, int depth, oob_decoder *dec );
+
+
+#endif  // _URING_H